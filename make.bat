@@ -29,6 +29,9 @@ set disabled=/wd4477 ^
 	/wd4101 ^
 	/D_CRT_SECURE_NO_WARNINGS
 
+rem Allocator instrumentation; F9 in game writes memory.json
+set debugDefines=/DWB_ALLOC_STATS
+
 if "%~1"=="release" goto ReleaseBuild
 if "%~1"=="wpl" goto WplBuild
 
@@ -41,6 +44,7 @@ if "%~1"=="wpl" goto WplBuild
 	/W3 ^
 	/fp:fast ^
 	%disabled% ^
+	%debugDefines% ^
 	/Iusr\include\ ^
 	src\wpl\wpl.c ^
 	/Fewpl.obj ^
@@ -58,6 +62,7 @@ del *.obj >NUL 2>&1
 	/W3 ^
 	/fp:fast ^
 	%disabled% ^
+	%debugDefines% ^
 	/Iusr\include\ ^
 	src\%filePrefix%Main.c ^
 	/Febin\%baseName%.exe ^
@@ -65,7 +70,7 @@ del *.obj >NUL 2>&1
 /link ^
 	/nologo ^
 	/LIBPATH:"usr\lib" ^
-	kernel32.lib user32.lib Shlwapi.lib wpl.lib ^
+	kernel32.lib user32.lib wpl.lib ^
 	/SUBSYSTEM:CONSOLE ^
 	/INCREMENTAL:NO
 
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Non-Windows build, for Linux boxes without a GPU as much as anything:
+#   ./make.sh            debug build
+#   ./make.sh release    optimized build
+#   ./make.sh run        debug build, then run it
+# Needs gcc or clang and SDL2's development files (sdl2-config).
+
+baseName=Haven
+filePrefix=ld40
+
+cc=${CC:-cc}
+sdlFlags=$(sdl2-config --cflags) || exit 1
+sdlLibs=$(sdl2-config --libs) || exit 1
+
+mkdir -p bin
+
+flags="-std=gnu11 -msse4.2 -ffast-math -Wall -Wno-unused -Wno-missing-braces -Iusr/include"
+
+# Allocator instrumentation; F9 in game writes memory.json
+debugDefines="-DWB_ALLOC_STATS"
+
+if [ "$1" = "release" ]; then
+	flags="$flags -O2"
+	debugDefines=""
+else
+	flags="$flags -g -O1"
+fi
+
+$cc $flags $debugDefines $sdlFlags -c src/wpl/wpl.c -o wpl.o || exit 1
+ar rcs libwpl.a wpl.o || exit 1
+rm -f wpl.o
+
+$cc $flags $debugDefines $sdlFlags src/${filePrefix}Main.c -o bin/$baseName \
+	-L. -lwpl $sdlLibs -lm -lpthread || exit 1
+
+echo Build Complete
+
+if [ "$1" = "run" ] || [ "$2" = "run" ]; then
+	cd bin && ./$baseName
+fi
@@ -132,9 +132,41 @@ enum PlayModes
 	Mode_NightEvents
 };
 
+/* Roster cards keep the text sprites they built, relative to the card, 
+ * and only rebuild them when something the card shows has changed */
+typedef struct ActorCardKey ActorCardKey;
+struct ActorCardKey
+{
+	string name;
+	int dead;
+	int mood, food, health, daysConsecutiveWork;
+	int job, state;
+	int positiveTraits[4];
+	int negativeTraits[4];
+	int contribution, contribType;
+};
+
+typedef struct ActorCard ActorCard;
+struct ActorCard
+{
+	ActorCardKey key;
+	int valid;
+	wplSprite* sprites;
+	isize count, capacity;
+
+	// What the card's background and face in play.cardGroup were last
+	// written with; they're only edited when this or the key changes
+	int placed;
+	f32 x, y;
+	u32 color;
+};
+
 struct PlayState {
 	MemoryArena* arena;
 	wplRenderGroup* group;
+	wplRenderGroup* bgGroup;
+	wplRenderGroup* cardGroup;
+	isize cardFirst, cardEnd;
 
 	struct Resources res;
 	struct Buildings bil;
@@ -144,6 +176,7 @@ struct PlayState {
 	isize removedCount;
 	isize deadCount;
 	f32 actorScroll;
+	ActorCard cards[256];
 
 	WorldEvent events[256];
 	int eventCount, activeEvent;
@@ -244,74 +277,44 @@ void addSpriteS(f32 x, f32 y, f32 w, f32 h, f32 tx, f32 ty, f32 s)
 
 #define ActorCardWidth 72
 #define ActorCardHeight 128
-void drawActor(Actor* actor, f32 x, f32 y)
+#define ActorCardStrideX 80
+#define ActorCardStrideY 136
+
+/* Formats drawn every frame, split up once */
+wplFormat formatMood = {"Mood:%d"};
+wplFormat formatCardFood = {"Food:%d"};
+wplFormat formatHP = {"HP: %d"};
+wplFormat formatWorked = {"Worked:\n%d days"};
+wplFormat formatProduced = {"Produced %d %s"};
+wplFormat formatCrafting = {"Crafting a %s: %d work left"};
+wplFormat formatBuilding = {"Building a %s: %d work left"};
+wplFormat formatFood = {"Food: %d"};
+wplFormat formatHuts = {"Huts: %d"};
+wplFormat formatWood = {"Wood: %d"};
+wplFormat formatFarms = {"Farms: %d"};
+wplFormat formatPopulation = {"Population %d"};
+wplFormat formatSmiths = {"Smiths: %d"};
+wplFormat formatTools = {"Tools: %d"};
+wplFormat formatWeapons = {"Weapons: %d"};
+wplFormat formatArtifacts = {"Artifacts: %d"};
+wplFormat formatDayTime = {"Day %d -- Time: %02d:%02d"};
+
+void drawActorText(Actor* actor, f32 x, f32 y)
 {
-	//box: 72 wide, 120+padding tall
-	if(actor->name == NULL) return;
-
-	wplSprite* s = wplGetSprite(play.group);
-	s->x = x;
-	s->y = y;
-	s->w = ActorCardWidth;
-	s->h = ActorCardHeight;
-	s->flags = Sprite_NoTexture | Anchor_TopLeft;
-	s->color = 0x00000099;
-
-	if(play.mode == Mode_DayEvents) {
-		if(play.activeEvent != -1) {
-			WorldEvent* e = play.events + play.activeEvent;
-			if(e->peopleToSelectMin > 0) {
-				if(e->jobSpecific != -1) {
-					int job = e->jobSpecific;
-					for(isize i = 0; i < e->involveCount; ++i) {
-						if(e->involves[i] == actor) {
-							s->color = 0x44;
-							break;
-						}
-					}
-
-					if(s->color != 0x44) {
-						if(job == actor->job) {
-							s->color = 0x11880099;
-						} else {
-							s->color = 0x66000099;
-						}
-					}
-				} else {
-					s->color = 0x33FF0099;
-				}
-			}
-		} else {
-			s->color = 0x00000099;
-		}
-	} else {
-		s->color = 0x00000099;
-	}
-
-	if(actor->selected) {
-		s->color = 0x666666CC;
-	} 
-
-	if(actor->sex) {
-		addSpriteS(x + 4, y, 64, 80, actor->faceX * 64 + 4 * 64, actor->faceY * 80, 0.5);
-	} else {
-		addSpriteS(x + 4, y, 64, 80, actor->faceX * 64, actor->faceY * 80, 0.5);
-	}
-
 	if(actor->health < -10) {
 		drawText(x + 4, y + 44, actor->name);
 		drawText(x + 4, y + 60, "is dead");
 		return;
 	}
 
-	char buf[256];
-	snprintf(buf, 256, "Mood:%d", actor->mood);
+	string buf;
+	buf = wplFrameFormat(&formatMood, actor->mood);
 	drawText(x + 40, y + 4, buf);
-	snprintf(buf, 256, "Food:%d", actor->food);
+	buf = wplFrameFormat(&formatCardFood, actor->food);
 	drawText(x + 40, y + 14, buf);
-	snprintf(buf, 256, "HP: %d", actor->health);
+	buf = wplFrameFormat(&formatHP, actor->health);
 	drawText(x + 40, y + 24, buf);
-	snprintf(buf, 256, "Worked:\n%d days", actor->daysConsecutiveWork);
+	buf = wplFrameFormat(&formatWorked, actor->daysConsecutiveWork);
 	drawText(x + 40, y + 34, buf);
 
 	drawText(x + 4, y + 44, actor->name);
@@ -330,19 +333,164 @@ void drawActor(Actor* actor, f32 x, f32 y)
 		}
 
 		if(nt > 0) {
-			drawTextR(x + s->w - 4, nty, negTraitNames[nt]);
+			drawTextR(x + ActorCardWidth - 4, nty, negTraitNames[nt]);
 			nty += 8;
 		}
 	}
 
 	if(actor->contribution > 0 && actor->contribType > 0) {
-		snprintf(buf, 256, "Produced %d %s", actor->contribution,
+		buf = wplFrameFormat(&formatProduced, actor->contribution,
 				jobContribType[actor->contribType]);
 
 		drawTextSW(x + 4, pty+8, buf, 0.5, 56);
 	}
 }
 
+u32 actorCardColor(Actor* actor)
+{
+	u32 color = 0x00000099;
+	if(play.mode == Mode_DayEvents && play.activeEvent != -1) {
+		WorldEvent* e = play.events + play.activeEvent;
+		if(e->peopleToSelectMin > 0) {
+			if(e->jobSpecific != -1) {
+				int job = e->jobSpecific;
+				for(isize i = 0; i < e->involveCount; ++i) {
+					if(e->involves[i] == actor) {
+						color = 0x44;
+						break;
+					}
+				}
+
+				if(color != 0x44) {
+					if(job == actor->job) {
+						color = 0x11880099;
+					} else {
+						color = 0x66000099;
+					}
+				}
+			} else {
+				color = 0x33FF0099;
+			}
+		}
+	}
+
+	if(actor->selected) {
+		color = 0x666666CC;
+	} 
+	return color;
+}
+
+/* Card i's background and face are sprites 2i and 2i+1 of the retained
+ * play.cardGroup, so a card that hasn't changed uploads nothing */
+void hideActorCard(isize index)
+{
+	ActorCard* card = play.cards + index;
+	if(!card->placed) return;
+	wplGroupTouch(play.cardGroup, index * 2, index * 2 + 2);
+	play.cardGroup->sprites[index * 2].flags |= Sprite_Hidden;
+	play.cardGroup->sprites[index * 2 + 1].flags |= Sprite_Hidden;
+	card->placed = 0;
+}
+
+void placeActorCard(isize index, Actor* actor, f32 x, f32 y, u32 color)
+{
+	wplRenderGroup* g = play.cardGroup;
+	while(g->count < index * 2 + 2) {
+		wplGroupAdd(g, Sprite_Hidden, 0, 0, 0, 0, 0, 0, 0, 0);
+	}
+
+	wplGroupTouch(g, index * 2, index * 2 + 2);
+	wplSprite* s = g->sprites + index * 2;
+	s->flags = Sprite_NoTexture | Anchor_TopLeft;
+	s->color = color;
+	s->x = x;
+	s->y = y;
+	s->w = ActorCardWidth;
+	s->h = ActorCardHeight;
+
+	s++;
+	s->flags = Anchor_TopLeft;
+	s->color = 0xFFFFFFFF;
+	s->x = x + 4;
+	s->y = y;
+	s->w = 64 * 0.5f;
+	s->h = 80 * 0.5f;
+	s->tx = actor->faceX * 64 + (actor->sex ? 4 * 64 : 0);
+	s->ty = actor->faceY * 80;
+	s->tw = 64;
+	s->th = 80;
+}
+
+void drawActor(Actor* actor, ActorCard* card, f32 x, f32 y)
+{
+	//box: 72 wide, 120+padding tall
+	isize index = card - play.cards;
+	if(actor->name == NULL) {
+		hideActorCard(index);
+		return;
+	}
+
+	ActorCardKey key;
+	memset(&key, 0, sizeof(key));
+	key.name = actor->name;
+	key.dead = actor->health < -10;
+	if(!key.dead) {
+		key.mood = actor->mood;
+		key.food = actor->food;
+		key.health = actor->health;
+		key.daysConsecutiveWork = actor->daysConsecutiveWork;
+		key.job = actor->job;
+		key.state = actor->state;
+		for(isize i = 0; i < 4; ++i) {
+			key.positiveTraits[i] = actor->positiveTraits[i];
+			key.negativeTraits[i] = actor->negativeTraits[i];
+		}
+		key.contribution = actor->contribution;
+		key.contribType = actor->contribType;
+	}
+	int same = card->valid && memcmp(&key, &card->key, sizeof(key)) == 0;
+
+	u32 color = actorCardColor(actor);
+	if(!same || !card->placed || 
+			card->x != x || card->y != y || card->color != color) {
+		placeActorCard(index, actor, x, y, color);
+		card->placed = 1;
+		card->x = x;
+		card->y = y;
+		card->color = color;
+	}
+
+	if(same) {
+		wplSprite* out = wplGroupAddSprites(textGroup, card->count);
+		for(isize i = 0; i < card->count; ++i) {
+			wplSprite t = card->sprites[i];
+			t.x += x;
+			t.y += y;
+			out[i] = t;
+		}
+		return;
+	}
+
+	// Draw it as usual, then keep a copy of what it added
+	isize start = textGroup->count;
+	drawActorText(actor, x, y);
+	isize count = textGroup->count - start;
+	if(count > card->capacity) {
+		card->capacity = count * 2;
+		card->sprites = arenaPush(play.arena, sizeof(wplSprite) * card->capacity);
+	}
+	wplSprite* src = textGroup->sprites + start;
+	for(isize i = 0; i < count; ++i) {
+		wplSprite t = src[i];
+		t.x -= x;
+		t.y -= y;
+		card->sprites[i] = t;
+	}
+	card->count = count;
+	card->key = key;
+	card->valid = 1;
+}
+
 int drawEventTab(WorldEvent* e, f32 x, f32 y)
 {
 	wplSprite* s = wplGetSprite(textGroup);
@@ -352,16 +500,9 @@ int drawEventTab(WorldEvent* e, f32 x, f32 y)
 	s->h = 24;
 	s->flags = Sprite_NoTexture | Anchor_TopLeft;
 
-	int mouseIn = 0, mouseState = 0;
-	f32 mx, my;
-	getMouse(textGroup, &mx, &my);
-	if(mx > x && my > y && mx < (x + s->w) && my < (y + s->h)) {
-		mouseIn = 1;
-		mouseState = wplMouseIsDown(1);
-		if(!mouseState) {
-			mouseState = wplMouseIsJustUp(1) * 2;
-		}
-	}
+	int mouseState;
+	int mouseIn = uiInteract(textGroup, uiId(Ui_EventTab, x, y),
+			x, y, s->w, s->h, &mouseState);
 
 	s->color = eventKindColors[e->kind];
 	s->color &= ~0xFF;
@@ -429,10 +570,10 @@ int drawEventPanel(WorldEvent* e, wplState* state)
 		f32 y = 22;
 		if(e->resultText) {
 			string tp = e->resultText;
-			char buf[256];
+			string buf;
 			if(e->involves[0]) {
 				if(stringContains(e->resultText, '%')) {
-					snprintf(buf, 256, e->resultText, e->involves[0]->name);
+					buf = wplFramePrintf(e->resultText, e->involves[0]->name);
 					tp = buf;
 				}
 			}
@@ -443,9 +584,9 @@ int drawEventPanel(WorldEvent* e, wplState* state)
 		int valueIndex = 0;
 		for(isize i = 0; i < e->resultCount; ++i) {
 			string tp = e->resultLines[i];
-			char buf[256];
+			string buf;
 			if(stringContains(e->resultLines[i], '%')) {
-				snprintf(buf, 256, e->resultLines[i], e->resultValues[valueIndex++]);
+				buf = wplFramePrintf(e->resultLines[i], e->resultValues[valueIndex++]);
 				tp = buf;
 			}
 			y += drawTextSW(s->x + 8, s->y + y, tp, 0.5, textWidth) * 0.5;
@@ -457,10 +598,10 @@ int drawEventPanel(WorldEvent* e, wplState* state)
 		int textPersonIndex = 0;
 		for(isize i = 0; i < e->textCount; ++i) {
 			string tp = e->text[i];
-			char buf[256];
+			string buf;
 			if(stringContains(e->text[i], '%')) {
 				if(e->involves[textPersonIndex]) {
-					snprintf(buf, 256, e->text[i], e->involves[textPersonIndex++]->name);
+					buf = wplFramePrintf(e->text[i], e->involves[textPersonIndex++]->name);
 					tp = buf;
 				}
 			}
@@ -473,9 +614,9 @@ int drawEventPanel(WorldEvent* e, wplState* state)
 		for(isize i = 0; i < e->optionCount; ++i) {
 			if(!e->options[i]) continue;
 			string tp = e->options[i];
-			char buf[256];
+			string buf;
 			if(stringContains(e->options[i], '%')) {
-				snprintf(buf, 256, e->options[i], e->involves[personIndex++]->name);
+				buf = wplFramePrintf(e->options[i], e->involves[personIndex++]->name);
 				tp = buf;
 			}
 			if(e->optionRequiresSelection == i) {
@@ -485,8 +626,8 @@ int drawEventPanel(WorldEvent* e, wplState* state)
 						eventResolved = 1;
 					}
 				} else {
-					char buf[256];
-					isize c = snprintf(buf, 256, "You need to select at least %d people",
+					string buf;
+					buf = wplFramePrintf("You need to select at least %d people",
 							e->peopleToSelectMin - e->peopleSelected);
 
 					drawText(16, opty, buf);
@@ -494,8 +635,8 @@ int drawEventPanel(WorldEvent* e, wplState* state)
 					drawText(16 + 8, opty, e->options[i]);
 				}
 			} else if(e->optionReqs[i].hasReq) {
-				char buf[256];
-				snprintf(buf, 256, "Cost: %d %s", e->optionReqs[i].amt, 
+				string buf;
+				buf = wplFramePrintf("Cost: %d %s", e->optionReqs[i].amt, 
 						resourceNames[e->optionReqs[i].resource]);
 				drawText(16, opty, buf);
 				opty += 10;
@@ -543,10 +684,25 @@ string topSecretConfidentialLetterFromTheDeveloper =
 void playInit(wplWindow* window)
 {
 	play.arena = arenaBootstrap(gMemInfo, 0);
+	play.arena->name = "play";
 	play.group = arenaPush(play.arena, sizeof(wplRenderGroup));
 	wplGroupInit(window, play.group, 2048,
 			gameData.shader, gameData.bgTex, play.arena);
 
+	// The background is one sprite that rarely changes; keep it around
+	play.bgGroup = arenaPush(play.arena, sizeof(wplRenderGroup));
+	wplGroupInit(window, play.bgGroup, 1,
+			gameData.shader, gameData.bgTex, play.arena);
+	wplGroupSetRetained(play.bgGroup, 1);
+	wplGroupAdd(play.bgGroup, 
+			Anchor_TopLeft, 0, 0, 0, 0, 0, 0, 1280, 720);
+
+	// Roster card backgrounds and faces, two sprites a card; see drawActor
+	play.cardGroup = arenaPush(play.arena, sizeof(wplRenderGroup));
+	wplGroupInit(window, play.cardGroup, 512,
+			gameData.shader, gameData.basicTex, play.arena);
+	wplGroupSetRetained(play.cardGroup, 1);
+
 	play.dayTimer = -1;
 	play.activeEvent = -1;
 	play.nextEventTime = DayTimeInFrames / 28;
@@ -555,10 +711,7 @@ void playInit(wplWindow* window)
 
 void playUpdate(wplWindow* window, wplState* state)
 {
-	play.group->texture = gameData.bgTex;
-	play.group->scale = 1;
-	wplSprite* bgs = wplGroupAdd(play.group, 
-			Anchor_TopLeft, 0, 0, state->width, state->height, 0, 0, 1280, 720);
+	u32 bgColor;
 	if(play.mode == Mode_DayEvents) {
 		f32 timep = (f32)play.dayTimer / (f32)DayTimeInFrames; 
 		int c = 0xFF;
@@ -574,15 +727,25 @@ void playUpdate(wplWindow* window, wplState* state)
 			if(a > 255) a = 255;
 		}
 
-		bgs->color = a << 24 | a << 16 | c << 8 | 0xFF;
+		bgColor = a << 24 | a << 16 | c << 8 | 0xFF;
 	} else {
 		if(play.dayTimer < 0) {
-			bgs->color = 0x333333FF;
+			bgColor = 0x333333FF;
 		} else {
-			bgs->color = 0;
+			bgColor = 0;
 		}
 	}
-	wplGroupDraw(window, state, play.group);
+
+	// Only touch the sprite when it changes, so most frames upload nothing
+	wplSprite* bgs = play.bgGroup->sprites;
+	if(bgs->color != bgColor || 
+			bgs->w != state->width || bgs->h != state->height) {
+		bgs = wplGroupEdit(play.bgGroup, 0);
+		bgs->color = bgColor;
+		bgs->w = state->width;
+		bgs->h = state->height;
+	}
+	wplBatchSubmit(window, state, frameBatch, play.bgGroup, Layer_Background);
 
 	play.group->scale = 2;
 	play.group->texture = gameData.basicTex;
@@ -591,14 +754,14 @@ void playUpdate(wplWindow* window, wplState* state)
 
 	if(world->actorCount <= 0) {
 		drawTextS(8, 8, "Everybody died. You lose.", 2);
-		wplGroupDraw(window, state, textGroup);
+		wplBatchSubmit(window, state, frameBatch, textGroup, Layer_Text);
 		return;
 	}
 
 	
 	if(wplKeyIsDown(65)) {
 		drawTextSW(8, 8, topSecretConfidentialLetterFromTheDeveloper, 0.5, state->width / 2 - 64);
-		wplGroupDraw(window, state, textGroup);
+		wplBatchSubmit(window, state, frameBatch, textGroup, Layer_Text);
 		return;
 	}
 	
@@ -607,42 +770,42 @@ void playUpdate(wplWindow* window, wplState* state)
 	if(world->resources.artifacts >= 3) {
 		drawTextS(4, 8, "You gathered all the artifacts! You win!", 2);
 
-		char buf[256];
+		string buf;
 
-		snprintf(buf, 256, "It took you %d days", world->day);
+		buf = wplFramePrintf("It took you %d days", world->day);
 		drawTextS(4, 32, buf, 2);
 		f32 by = 64;
-		snprintf(buf, 256, "Food: %d", world->resources.food);
+		buf = wplFrameFormat(&formatFood, world->resources.food);
 		drawText(8, by, buf);
 
-		snprintf(buf, 256, "Huts: %d", world->buildings.huts);
+		buf = wplFrameFormat(&formatHuts, world->buildings.huts);
 		drawText(96, by, buf);
 		by += 10;
 
-		snprintf(buf, 256, "Wood: %d", world->resources.wood);
+		buf = wplFrameFormat(&formatWood, world->resources.wood);
 		drawText(8, by, buf);
-		snprintf(buf, 256, "Farms: %d", world->buildings.farms);
+		buf = wplFrameFormat(&formatFarms, world->buildings.farms);
 		drawText(96, by, buf);
 		by += 10;
 
-		snprintf(buf, 256, "Population %d", world->actorCount);
+		buf = wplFrameFormat(&formatPopulation, world->actorCount);
 		drawText(8, by, buf);
-		snprintf(buf, 256, "Smiths: %d", world->buildings.smiths);
+		buf = wplFrameFormat(&formatSmiths, world->buildings.smiths);
 		drawText(96, by, buf);
 		by += 10;
-		snprintf(buf, 256, "Tools: %d", world->resources.tools);
+		buf = wplFrameFormat(&formatTools, world->resources.tools);
 		drawText(8, by, buf);
 		by += 10;
 
-		snprintf(buf, 256, "Weapons: %d", world->resources.weapons);
+		buf = wplFrameFormat(&formatWeapons, world->resources.weapons);
 		drawText(8, by, buf);
 		by += 10;
 
-		snprintf(buf, 256, "Artifacts: %d", world->resources.artifacts);
+		buf = wplFrameFormat(&formatArtifacts, world->resources.artifacts);
 		drawText(8, by, buf);
 		by += 10;
 
-		wplGroupDraw(window, state, textGroup);
+		wplBatchSubmit(window, state, frameBatch, textGroup, Layer_Text);
 		return;
 	}
 
@@ -733,8 +896,8 @@ void playUpdate(wplWindow* window, wplState* state)
 		if(world->craftTarget == 0) {
 			drawText(8, 36, "No crafting target");
 		} else {
-			char buf[256];
-			snprintf(buf, 256, "Crafting a %s: %d work left", 
+			string buf;
+			buf = wplFrameFormat(&formatCrafting, 
 					craftTargets[world->craftTarget], world->craftWorkNeeded);
 			drawText(8, 36, buf);
 		}
@@ -742,42 +905,42 @@ void playUpdate(wplWindow* window, wplState* state)
 		if(world->buildTarget == 0) {
 			drawText(8, 44, "No building target");
 		} else {
-			char buf[256];
-			snprintf(buf, 256, "Building a %s: %d work left", 
+			string buf;
+			buf = wplFrameFormat(&formatBuilding, 
 					buildTargets[world->buildTarget], world->buildWorkNeeded);
 			drawText(8, 44, buf);
 		}
 
 		f32 by = 64;
 		
-		char buf[256];
-		snprintf(buf, 256, "Food: %d", world->resources.food);
+		string buf;
+		buf = wplFrameFormat(&formatFood, world->resources.food);
 		drawText(8, by, buf);
 
-		snprintf(buf, 256, "Huts: %d", world->buildings.huts);
+		buf = wplFrameFormat(&formatHuts, world->buildings.huts);
 		drawText(96, by, buf);
 		by += 10;
 
-		snprintf(buf, 256, "Wood: %d", world->resources.wood);
+		buf = wplFrameFormat(&formatWood, world->resources.wood);
 		drawText(8, by, buf);
-		snprintf(buf, 256, "Farms: %d", world->buildings.farms);
+		buf = wplFrameFormat(&formatFarms, world->buildings.farms);
 		drawText(96, by, buf);
 		by += 10;
 
-		snprintf(buf, 256, "Population %d", world->actorCount);
+		buf = wplFrameFormat(&formatPopulation, world->actorCount);
 		drawText(8, by, buf);
-		snprintf(buf, 256, "Smiths: %d", world->buildings.smiths);
+		buf = wplFrameFormat(&formatSmiths, world->buildings.smiths);
 		drawText(96, by, buf);
 		by += 10;
-		snprintf(buf, 256, "Tools: %d", world->resources.tools);
+		buf = wplFrameFormat(&formatTools, world->resources.tools);
 		drawText(8, by, buf);
 		by += 10;
 
-		snprintf(buf, 256, "Weapons: %d", world->resources.weapons);
+		buf = wplFrameFormat(&formatWeapons, world->resources.weapons);
 		drawText(8, by, buf);
 		by += 10;
 
-		snprintf(buf, 256, "Artifacts: %d", world->resources.artifacts);
+		buf = wplFrameFormat(&formatArtifacts, world->resources.artifacts);
 		drawText(8, by, buf);
 		by += 10;
 
@@ -1263,27 +1426,27 @@ void playUpdate(wplWindow* window, wplState* state)
 			f32 minutes = hours - (int)hours;
 			minutes *= 60;
 
-			char buf[256];
-			snprintf(buf, 256, "Day %d -- Time: %02d:%02d", world->day, (int)hours, (int)minutes);
+			string buf;
+			buf = wplFrameFormat(&formatDayTime, world->day, (int)hours, (int)minutes);
 			drawText(16, 16, buf);
 
 			if(play.activeEvent == -1) {
 				f32 y = 26;
-				snprintf(buf, 256, "Food: %d", world->resources.food);
+				buf = wplFrameFormat(&formatFood, world->resources.food);
 				drawText(16, y, buf);
-				snprintf(buf, 256, "Tools: %d", world->resources.tools);
+				buf = wplFrameFormat(&formatTools, world->resources.tools);
 				drawTextR(s->w, y, buf);
 				y += 8;
 
-				snprintf(buf, 256, "Wood: %d", world->resources.wood);
+				buf = wplFrameFormat(&formatWood, world->resources.wood);
 				drawText(16, y, buf);
-				snprintf(buf, 256, "Weapons: %d", world->resources.weapons);
+				buf = wplFrameFormat(&formatWeapons, world->resources.weapons);
 				drawTextR(s->w, y, buf);
 				y += 8;
 
-				snprintf(buf, 256, "Population %d", world->actorCount);
+				buf = wplFrameFormat(&formatPopulation, world->actorCount);
 				drawText(16, y, buf);
-				snprintf(buf, 256, "Artifacts: %d", world->resources.artifacts);
+				buf = wplFrameFormat(&formatArtifacts, world->resources.artifacts);
 				drawTextR(s->w, y, buf);
 				y += 8;
 			} else {
@@ -1330,7 +1493,7 @@ void playUpdate(wplWindow* window, wplState* state)
 		}
 
 		if(play.dayTimer < 0) {
-			char buf[256];
+			string buf;
 			f32 y = 48;
 			struct Resources resdiff;
 			struct Resources w = world->resources;
@@ -1342,25 +1505,25 @@ void playUpdate(wplWindow* window, wplState* state)
 			resdiff.tools = w.tools - p.tools;
 			resdiff.weapons = w.weapons - p.weapons;
 
-			snprintf(buf, 256, "Summary for Day %d", world->day);
+			buf = wplFramePrintf("Summary for Day %d", world->day);
 			drawTextS(16, y, buf, 1);
 			y += 32;
-			snprintf(buf, 256, "Population: %d -> %d (%d)", p.population, w.population, resdiff.population);
+			buf = wplFramePrintf("Population: %d -> %d (%d)", p.population, w.population, resdiff.population);
 			drawText(16, y, buf);
 			y += 16;
-			snprintf(buf, 256, "Food: %d -> %d (%d)", p.food, w.food, resdiff.food);
+			buf = wplFramePrintf("Food: %d -> %d (%d)", p.food, w.food, resdiff.food);
 			drawText(16, y, buf);
 			y += 16;
 
-			snprintf(buf, 256, "Wood: %d -> %d (%d)", p.wood, w.wood, resdiff.wood);
+			buf = wplFramePrintf("Wood: %d -> %d (%d)", p.wood, w.wood, resdiff.wood);
 			drawText(16, y, buf);
 			y += 16;
 
-			snprintf(buf, 256, "Tools: %d -> %d (%d)", p.tools, w.tools, resdiff.tools);
+			buf = wplFramePrintf("Tools: %d -> %d (%d)", p.tools, w.tools, resdiff.tools);
 			drawText(16, y, buf);
 			y += 16;
 
-			snprintf(buf, 256, "Weapons: %d -> %d (%d)", p.weapons, w.weapons, resdiff.weapons);
+			buf = wplFramePrintf("Weapons: %d -> %d (%d)", p.weapons, w.weapons, resdiff.weapons);
 			drawText(16, y, buf);
 			y += 32;
 
@@ -1372,20 +1535,20 @@ void playUpdate(wplWindow* window, wplState* state)
 			bd.farms = wb.farms - pd.farms;
 			bd.smiths = wb.smiths - pd.smiths;
 
-			snprintf(buf, 256, "Huts: %d -> %d (%d)", pd.huts, wb.huts, bd.huts);
+			buf = wplFramePrintf("Huts: %d -> %d (%d)", pd.huts, wb.huts, bd.huts);
 			drawText(16, y, buf);
 			y += 16;
 
-			snprintf(buf, 256, "Farms: %d -> %d (%d)", pd.farms, wb.farms, bd.farms);
+			buf = wplFramePrintf("Farms: %d -> %d (%d)", pd.farms, wb.farms, bd.farms);
 			drawText(16, y, buf);
 			y += 16;
 
-			snprintf(buf, 256, "Smiths: %d -> %d (%d)", pd.smiths, wb.smiths, bd.smiths);
+			buf = wplFramePrintf("Smiths: %d -> %d (%d)", pd.smiths, wb.smiths, bd.smiths);
 			drawText(16, y, buf);
 
 
 			/*
-			snprintf(buf, 256, "Food: %d", world->resources.food);
+			buf = wplFrameFormat(&formatFood, world->resources.food);
 			drawText(4, y, buf);
 			y += 14;
 
@@ -1396,11 +1559,11 @@ void playUpdate(wplWindow* window, wplState* state)
 				y += 14;
 			}
 
-			snprintf(buf, 256, "Wood: %d", world->resources.wood);
+			buf = wplFrameFormat(&formatWood, world->resources.wood);
 			drawText(4, y, buf);
 			y += 14;
 
-			snprintf(buf, 256, "Population %d", world->actorCount);
+			buf = wplFrameFormat(&formatPopulation, world->actorCount);
 			drawText(4, y, buf);
 			y += 18;
 			*/
@@ -1408,7 +1571,7 @@ void playUpdate(wplWindow* window, wplState* state)
 			for(isize i = 0; i < play.deadCount; ++i)  {
 				string a = play.deadNames[i];
 				if(a == NULL) continue;
-				snprintf(buf, 256, "%s died", a);
+				buf = wplFramePrintf("%s died", a);
 				drawText(4, y, buf);
 				y += 10;
 			}
@@ -1434,60 +1597,78 @@ void playUpdate(wplWindow* window, wplState* state)
 	f32 ax = state->width / 4 - ActorCardWidth - 8, ay = 8 - play.actorScroll;
 	drawText(ax, ay, "Haven (for LD40) - by William Bundy - williambundy.xyz - @William_Bundy - github.com/WilliamBundy");
 	ay += 16;
-	for(isize i = 0; i < world->actorCount; ++i) {
-		Actor* a = world->actors + i;
-		//drawActor(a, state->width / 4 + i * 80, 8);
-		if(play.mode == Mode_MorningAssign) {
-			if(wplMouseIsJustDown(1)) {
-				f32 mx, my;
-				getMouse(play.group, &mx, &my);
-				if(mx > ax && my > ay && 
-						mx < (ax + ActorCardWidth) && 
-						my < (ay + ActorCardHeight)) {
-					a->job = (a->job + 1) % ActorJobCount;
-				}
-			}
-		} else if(play.activeEvent != -1) {
-			if(wplMouseIsJustDown(1)) {
-				f32 mx, my;
-				getMouse(play.group, &mx, &my);
-				if(mx > ax && my > ay && 
-						mx < (ax + ActorCardWidth) && 
-						my < (ay + ActorCardHeight)) {
-					WorldEvent* event = play.events + play.activeEvent;
-					int canSelect = 1;
-					for(isize i = 0; i < event->involveCount; ++i) {
-						if(event->involves[i] == a) {
-							canSelect = 0;
-							break;
-						}
+
+	// The roster is a grid; only the rows on screen are drawn or hit 
+	// tested, so its cost doesn't grow with the population
+	f32 rosterX = ax, rosterY = ay;
+	isize columns = 1;
+	while(rosterX + (columns + 1) * ActorCardStrideX <= state->width / 2) {
+		columns++;
+	}
+
+	if(wplMouseIsJustDown(1) && 
+			(play.mode == Mode_MorningAssign || play.activeEvent != -1)) {
+		f32 mx, my;
+		getMouse(play.group, &mx, &my);
+		isize col = (isize)floorf((mx - rosterX) / ActorCardStrideX);
+		isize row = (isize)floorf((my - rosterY) / ActorCardStrideY);
+		f32 cx = rosterX + col * ActorCardStrideX;
+		f32 cy = rosterY + row * ActorCardStrideY;
+		isize i = row * columns + col;
+		if(col >= 0 && col < columns && row >= 0 && i < world->actorCount &&
+				mx > cx && my > cy && 
+				mx < (cx + ActorCardWidth) && 
+				my < (cy + ActorCardHeight)) {
+			Actor* a = world->actors + i;
+			if(play.mode == Mode_MorningAssign) {
+				a->job = (a->job + 1) % ActorJobCount;
+			} else {
+				WorldEvent* event = play.events + play.activeEvent;
+				int canSelect = 1;
+				for(isize j = 0; j < event->involveCount; ++j) {
+					if(event->involves[j] == a) {
+						canSelect = 0;
+						break;
 					}
-					if(canSelect) {
-						if(!a->selected) {
-							if(event->peopleSelected < event->peopleToSelectMax) {
-								a->selected = 1;
-								event->peopleSelected++;
-							}
-						} else {
-							a->selected = 0;
-							event->peopleSelected--;
+				}
+				if(canSelect) {
+					if(!a->selected) {
+						if(event->peopleSelected < event->peopleToSelectMax) {
+							a->selected = 1;
+							event->peopleSelected++;
 						}
-
+					} else {
+						a->selected = 0;
+						event->peopleSelected--;
 					}
 				}
-
 			}
-
-		}
-		drawActor(a, ax, ay);
-		ax += 80;
-		if(ax + 80 > state->width / 2) {
-			ax = state->width / 4 - ActorCardWidth - 8;
-			ay += 136;
 		}
 	}
 
-	wplGroupDraw(window, state, play.group);
+	f32 viewHeight = state->height / play.group->scale;
+	isize firstRow = (isize)floorf(-rosterY / ActorCardStrideY);
+	isize lastRow = (isize)floorf((viewHeight - rosterY) / ActorCardStrideY);
+	if(firstRow < 0) firstRow = 0;
+	isize first = firstRow * columns;
+	isize end = (lastRow + 1) * columns;
+	if(end > world->actorCount) end = world->actorCount;
+	for(isize i = play.cardFirst; i < play.cardEnd; ++i) {
+		if(i < first || i >= end) hideActorCard(i);
+	}
+	play.cardFirst = first;
+	play.cardEnd = end;
+	for(isize i = first; i < end; ++i) {
+		Actor* a = world->actors + i;
+		drawActor(a, play.cards + i, 
+				rosterX + (i % columns) * ActorCardStrideX, 
+				rosterY + (i / columns) * ActorCardStrideY);
+	}
+
+	wplBatchSubmit(window, state, frameBatch, play.group, Layer_World);
+	play.cardGroup->scale = play.group->scale;
+	play.cardGroup->texture = gameData.basicTex;
+	wplBatchSubmit(window, state, frameBatch, play.cardGroup, Layer_World);
 	textGroup->scale = play.group->scale;
-	wplGroupDraw(window, state, textGroup);
+	wplBatchSubmit(window, state, frameBatch, textGroup, Layer_Text);
 }
@@ -1,7 +1,9 @@
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
-#include <Shlwapi.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "wpl/wpl.h"
 #include "vmath.c"
@@ -30,6 +32,8 @@ struct {
 	wplTexture* basicTex;
 	wplTexture* bgTex;
 	wplTexture* gohufontTex;
+	wplTexture* atlas;
+	i32 texturesPacked;
 	Spritefont font;
 } gameData;
 
@@ -52,7 +56,8 @@ int loadGame(wplWindow* window, World* world)
 {
 	char buf[1024];
 	snprintf(buf, 1024, "%shaven.save", window->basePath);
-	if(!PathFileExists(buf)) return 0;
+	struct stat st;
+	if(stat(buf, &st) != 0) return 0;
 	FILE* f = fopen(buf, "rb");
 	if(f) {
 		fread(world, sizeof(World), 1, f);
@@ -63,29 +68,46 @@ int loadGame(wplWindow* window, World* world)
 
 int gameLoaded = 0;
 
+#ifdef WB_ALLOC_STATS
+void dumpMemoryStats(wplWindow* window)
+{
+	char buf[1024];
+	snprintf(buf, 1024, "%smemory.json", window->basePath);
+	if(!memoryStatsDumpJson(buf)) {
+		fprintf(stderr, "Error: could not write %s\n", buf);
+	}
+}
+#endif
+
 void init(wplWindow* window)
 {
 	createEventTemplates(eventTemplates, &eventTemplateCount);
 	gameData.shader = arenaPush(arena, sizeof(wplShader));
-	gameData.basicTex = wplLoadTexture(window, "faces.png", arena);
-	gameData.bgTex = wplLoadTexture(window, "bg.png", arena);
-	gameData.gohufontTex = wplLoadTexture(window, "gohufont.png", arena);
-	wplUploadTexture(gameData.basicTex);
-	wplUploadTexture(gameData.bgTex);
-	wplUploadTexture(gameData.gohufontTex);
+	// Decoded in the background; packTextures picks them up once they're in
+	gameData.basicTex = wplLoadTextureAsync(window, "faces.png", arena);
+	gameData.bgTex = wplLoadTextureAsync(window, "bg.png", arena);
+	gameData.gohufontTex = wplLoadTextureAsync(window, "gohufont.png", arena);
 
 	textGroup = arenaPush(arena, sizeof(wplRenderGroup));
 	wplGroupInit(window, textGroup, 2048, gameData.shader,
 			gameData.gohufontTex, arena);
 
 	gameData.font.glyphs = gohufontRects;
+	// Lets the batch send text as glyph indices instead of full sprites
+	textGroup->glyphs = wplCreateGlyphTable((i16*)gohufontRects, 
+			sizeof(gohufontRects) / sizeof(Rect2i), arena);
+
+	frameBatch = arenaPush(arena, sizeof(wplBatch));
+	wplBatchInit(window, frameBatch, 8192, gameData.shader, arena);
 
 	playInit(window);
 	
 	//TODO(will): implement world save/load
 	// temporary worldgen/setup goes here
 	play.world = arenaPush(play.arena, sizeof(World));
-	int loaded = loadGame(window, play.world);
+	// Headless runs are compared against reference images, so they don't
+	// pick up a save and always generate the same world
+	int loaded = window->soft ? 0 : loadGame(window, play.world);
 	if(play.world->actorCount == 0) loaded = 0;
 
 	gameLoaded = loaded;
@@ -102,7 +124,7 @@ void init(wplWindow* window)
 		}
 	} else {
 		play.world->r = &play.world->randomState;
-		initRandom(play.world->r, 1123 * time(0));
+		initRandom(play.world->r, window->soft ? 1123 : 1123 * time(0));
 		play.world->day = 1;
 		play.world->buildings.huts = 1;
 		play.world->resources.wood = 20;
@@ -114,8 +136,33 @@ void init(wplWindow* window)
 	}
 }
 
+/* Packs the atlas as soon as all its images have decoded, and queues it
+ * (and anything that didn't fit) for upload. Groups using them just 
+ * don't draw until that's done. */
+void packTextures(void)
+{
+	wplTexture* images[] = {
+		gameData.basicTex, 
+		gameData.bgTex, 
+		gameData.gohufontTex
+	};
+	if(gameData.texturesPacked || !wplTexturesDecoded(images, 3)) return;
+	gameData.texturesPacked = 1;
+
+	gameData.atlas = wplPackAtlas(images, 3, 4096, arena);
+	if(gameData.atlas) {
+		wplUploadTextureAsync(gameData.atlas);
+	}
+	for(isize i = 0; i < 3; ++i) {
+		if(!images[i]->atlas) {
+			wplUploadTextureAsync(images[i]);
+		}
+	}
+}
+
 void update(wplWindow* window, wplState* state)
 {
+	packTextures();
 	if(gameLoaded) {
 		if(uiButtonL(8, state->height / 8 - 16, "Load save game")) {
 			gameLoaded = 0;
@@ -135,17 +182,57 @@ void update(wplWindow* window, wplState* state)
 			gameLoaded = 0;
 		}
 		textGroup->scale = 4;
-		wplGroupDraw(window, state, textGroup);
+		wplBatchSubmit(window, state, frameBatch, textGroup, Layer_Text);
 	} else {
 		playUpdate(window, state);
 	}
 }
 
+/* --bench-format: the roster card and resource panel strings, through
+ * snprintf and through their wplFormats */
+void benchFormat()
+{
+	char buf[256];
+	isize n = 200000;
+	volatile isize sink = 0;
+	f64 start = wplGetTimeMs();
+	for(isize i = 0; i < n; ++i) {
+		int v = (int)(i * 37 % 2000) - 500;
+		sink += snprintf(buf, 256, "Mood:%d", v);
+		sink += snprintf(buf, 256, "HP: %d", v);
+		sink += snprintf(buf, 256, "Worked:\n%d days", v);
+		sink += snprintf(buf, 256, "Produced %d %s", v, "food");
+		sink += snprintf(buf, 256, "Population %d", v);
+		sink += snprintf(buf, 256, "Day %d -- Time: %02d:%02d", v, 7, 5);
+	}
+	f64 printfMs = wplGetTimeMs() - start;
+
+	start = wplGetTimeMs();
+	for(isize i = 0; i < n; ++i) {
+		int v = (int)(i * 37 % 2000) - 500;
+		sink += wplFormatTo(buf, 256, &formatMood, v);
+		sink += wplFormatTo(buf, 256, &formatHP, v);
+		sink += wplFormatTo(buf, 256, &formatWorked, v);
+		sink += wplFormatTo(buf, 256, &formatProduced, v, "food");
+		sink += wplFormatTo(buf, 256, &formatPopulation, v);
+		sink += wplFormatTo(buf, 256, &formatDayTime, v, 7, 5);
+	}
+	f64 formatMs = wplGetTimeMs() - start;
+
+	f64 calls = (f64)n * 6;
+	printf("snprintf:  %.1fns/call\n", printfMs * 1000000.0 / calls);
+	printf("wplFormat: %.1fns/call\n", formatMs * 1000000.0 / calls);
+}
+
 int main(int argc, char** argv)
 {
+	wplStartupMark("main");
+	wplInit();
 	gMemInfo = getMemoryInfo();
 	arena = arenaBootstrap(gMemInfo, 0);
+	arena->name = "main";
 	tempArena = arenaBootstrap(gMemInfo, FlagArenaStack);
+	tempArena->name = "temp";
 
 	wplWindowDef def = {0};
 	def.title = "Haven";
@@ -153,17 +240,66 @@ int main(int argc, char** argv)
 	def.monitorIndex = 1;
 	//def.resizeable = 1;
 
+	// --headless frames out.png draws that many frames with the software
+	// renderer and writes the last one out, for checking renders without
+	// a GPU
+	i64 headlessFrames = 0;
+	string headlessOut = NULL;
+	if(argc >= 4 && strcmp(argv[1], "--headless") == 0) {
+		def.headless = 1;
+		headlessFrames = atoi(argv[2]);
+		headlessOut = argv[3];
+	}
+
+	// --headless-compare frames ref.png [tolerance] draws the same way,
+	// then fails if the last frame is off from ref.png by more than
+	// tolerance in any channel
+	string headlessRef = NULL;
+	i32 tolerance = 0;
+	if(argc >= 4 && strcmp(argv[1], "--headless-compare") == 0) {
+		def.headless = 1;
+		headlessFrames = atoi(argv[2]);
+		headlessRef = argv[3];
+		if(argc >= 5) tolerance = atoi(argv[4]);
+	}
+
+	// --bench-render frames draws that many frames headless and prints
+	// how long batching and rasterizing took per frame
+	i32 benchRender = 0;
+	if(argc >= 3 && strcmp(argv[1], "--bench-render") == 0) {
+		def.headless = 1;
+		headlessFrames = atoi(argv[2]);
+		benchRender = 1;
+	}
+
+	// --startup-profile prints how long each step took to get to the 
+	// first frame that has the font texture in it
+	i32 startupProfile = 0;
+	for(i32 i = 1; i < argc; ++i) {
+		if(strcmp(argv[i], "--startup-profile") == 0) {
+			startupProfile = 1;
+		}
+		if(strcmp(argv[i], "--bench-format") == 0) {
+			benchFormat();
+			return 0;
+		}
+	}
+
 	wplWindow window;
 	if(!wplCreateWindow(&def, &window)) {
 		fprintf(stderr, "Error: could not create window\n");
 	}
 
 	init(&window);
+	wplStartupMark("game init");
 	
 	wplState state = {0};
 	wplInputState inputState = {0};
 	state.input = &inputState;
 	state.input->keyboard = state.input->scancodes;
+	int result = 0;
+	f64 renderMs = 0;
+	i64 renderFrames = 0, renderSprites = 0;
 	while(1) {
 		if(!wplUpdate(&window, &state)) {
 			if(play.mode == Mode_MorningAssign) {
@@ -171,12 +307,96 @@ int main(int argc, char** argv)
 			}
 			break;
 		}
+		// Headless frames only count from when the textures are in, so a
+		// run draws the same frames however long the decode took
+		if(def.headless && !wplTextureReady(gameData.gohufontTex)) {
+			packTextures();
+			if(gameData.gohufontTex->status == Texture_Failed) {
+				fprintf(stderr, "Error: could not load gohufont.png\n");
+				result = 1;
+				break;
+			}
+			wplRender(&window);
+			wplSleep(1);
+			continue;
+		}
+		textCacheNewFrame();
+		uiNewFrame();
 		mouseX = state.mouseX;
 		mouseY = state.mouseY;
 		update(&window, &state);
 		if(state.exitEvent) {
 			break;
 		}
+		//F3
+		if(wplKeyIsJustDown(60)) {
+			wplProfileEnable(&window, !wplGetProfile()->enabled);
+		}
+		if(wplGetProfile()->enabled) {
+			drawProfileOverlay(&window, &state);
+		}
+		f64 renderStart = wplGetTimeMs();
+		wplBatchFlush(frameBatch);
+		renderMs += wplGetTimeMs() - renderStart;
+		renderSprites += frameBatch->lastSubmitted;
+		//F9
+		if(wplKeyIsJustDown(66)) {
+			printf("Frame: %d sprites, %d culled, %d draw calls "
+					"(%d spilled), %d state changes, %d bytes uploaded\n", 
+					(int)frameBatch->lastSubmitted, 
+					(int)frameBatch->lastCulled,
+					(int)frameBatch->lastDrawCalls, 
+					(int)frameBatch->lastSpills,
+					(int)frameBatch->lastStateChanges,
+					(int)frameBatch->lastUploaded);
+			printf("Text cache: %d runs, %d hits, %d misses\n",
+					(int)textCache.count, (int)textCache.hits, 
+					(int)textCache.misses);
+#ifdef WB_ALLOC_STATS
+			dumpMemoryStats(&window);
+#endif
+		}
+		renderStart = wplGetTimeMs();
 		wplRender(&window);
+		renderMs += wplGetTimeMs() - renderStart;
+		renderFrames++;
+		if(startupProfile && wplTextureReady(gameData.gohufontTex)) {
+			wplStartupMark("first textured frame");
+			wplStartupPrint();
+			startupProfile = 0;
+		}
+		if(def.headless && --headlessFrames <= 0) {
+			if(headlessOut) {
+				wplSoftWriteImage(window.soft, headlessOut);
+			}
+			if(headlessRef) {
+				i32 maxDiff;
+				i64 differ = wplSoftCompareImage(window.soft, 
+						headlessRef, tolerance, &maxDiff);
+				if(differ < 0) {
+					fprintf(stderr, "Error: could not read %s, "
+							"or it isn't %dx%d\n", headlessRef, 
+							(int)window.soft->w, (int)window.soft->h);
+					result = 1;
+				} else if(differ > 0) {
+					fprintf(stderr, "%d pixels differ from %s "
+							"(worst channel off by %d)\n", 
+							(int)differ, headlessRef, maxDiff);
+					result = 1;
+				}
+			}
+			if(benchRender) {
+				printf("Render: %.3fms/frame, %d sprites/frame over %d frames\n",
+						renderMs / renderFrames, 
+						(int)(renderSprites / renderFrames), 
+						(int)renderFrames);
+			}
+			break;
+		}
 	}
+
+#ifdef WB_ALLOC_STATS
+	dumpMemoryStats(&window);
+#endif
+	return result;
 }
@@ -1,27 +1,347 @@
 
-void fontDrawText(Spritefont* font, wplRenderGroup* group, f32 x, f32 y, string txt, isize len, f32 scale, u32 color)
+/* Glyph runs. Laid-out text is cached by (contents, scale, wrap width),
+ * relative to (0, 0), so a string that was drawn last frame costs a hash,
+ * a compare and a copy into the group. Runs live in one of two arenas;
+ * when the current one passes its budget (or the table fills up), runs
+ * used in the last TextCacheMaxAge frames move to the other one and the
+ * rest are dropped. */
+#define TextCacheSlots 4096
+#define TextCacheMaxAge 120
+#define TextCacheBudget (2 << 20)
+#define TextNoWrap -1.0f
+
+typedef struct TextLine TextLine;
+struct TextLine
+{
+	i32 start, end;
+};
+
+typedef struct TextRun TextRun;
+struct TextRun
+{
+	u64 hash;
+	f32 scale, width;
+	isize len;
+	char* text;
+	wplSprite* sprites;
+	isize count;
+	// The same glyphs as instances, for groups with a glyph table, or 
+	// NULL if the scale or positions don't fit one; glyphMaxX and Y are
+	// the furthest any is placed, in WPL_PACKED_UNITs
+	wplGlyphSprite* glyphs;
+	i32 glyphMaxX, glyphMaxY;
+	// Where each line starts and ends in text
+	TextLine* lines;
+	isize lineCount;
+	// Where a wrapped run ends, for fontDrawTextWrapped
+	f32 height;
+	i64 lastUsed;
+};
+
+struct TextCache
+{
+	TextRun runs[TextCacheSlots];
+	isize count;
+	MemoryArena* arenas[2];
+	ArenaCheckpoint starts[2];
+	i32 current;
+	isize used, budget;
+	i64 frame;
+	i64 hits, misses;
+} textCache;
+
+void textCacheNewFrame()
+{
+	textCache.frame++;
+}
+
+static
+u64 textHash(string txt, isize* len, f32 scale, f32 width)
+{
+	u64 hash = 14695981039346656037ULL;
+	isize i = 0;
+	if(*len == -1) {
+		for(; txt[i]; ++i) {
+			hash = (hash ^ (u8)txt[i]) * 1099511628211ULL;
+		}
+		*len = i;
+	} else {
+		for(; i < *len; ++i) {
+			hash = (hash ^ (u8)txt[i]) * 1099511628211ULL;
+		}
+	}
+	u32 bits[2];
+	memcpy(bits, &scale, 4);
+	memcpy(bits + 1, &width, 4);
+	hash = (hash ^ bits[0]) * 1099511628211ULL;
+	hash = (hash ^ bits[1]) * 1099511628211ULL;
+	// 0 marks an empty slot
+	return hash ? hash : 1;
+}
+
+static
+TextRun* textCacheSlot(u64 hash)
+{
+	isize i = hash & (TextCacheSlots - 1);
+	while(textCache.runs[i].hash && textCache.runs[i].hash != hash) {
+		i = (i + 1) & (TextCacheSlots - 1);
+	}
+	return textCache.runs + i;
+}
+
+static
+void textCacheStore(TextRun* run, TextRun* from)
+{
+	MemoryArena* a = textCache.arenas[textCache.current];
+	if(!run->hash) {
+		textCache.count++;
+	}
+	*run = *from;
+	run->text = arenaPush(a, from->len + 1);
+	memcpy(run->text, from->text, from->len);
+	run->text[from->len] = '\0';
+	run->sprites = NULL;
+	run->glyphs = NULL;
+	if(from->count) {
+		run->sprites = arenaPush(a, sizeof(wplSprite) * from->count);
+		memcpy(run->sprites, from->sprites, sizeof(wplSprite) * from->count);
+		if(from->glyphs) {
+			run->glyphs = arenaPush(a, sizeof(wplGlyphSprite) * from->count);
+			memcpy(run->glyphs, from->glyphs, sizeof(wplGlyphSprite) * from->count);
+			textCache.used += sizeof(wplGlyphSprite) * from->count;
+		}
+	}
+	run->lines = arenaPush(a, sizeof(TextLine) * from->lineCount);
+	memcpy(run->lines, from->lines, sizeof(TextLine) * from->lineCount);
+	textCache.used += from->len + 1 + 
+		sizeof(wplSprite) * from->count + 
+		sizeof(TextLine) * from->lineCount;
+}
+
+/* Moves the runs that are still in use to the other arena and rebuilds
+ * the table around them */
+static
+void textCacheCollect()
 {
-	if(len == -1) len = strlen(txt);
-	Vec2 initialPos = v2(x, y);
-	Vec2 pos = v2(0, 0);
-	for(isize i = 0; i < len; ++i) {
-		char c = txt[i];
-		if(c == '\n') {
-			pos.x = 0;
-			pos.y += (font->glyphs[1].h + 2) * scale;
+	MemoryArena* scratch = arenaThreadScratch();
+	ArenaCheckpoint cp = arenaCheckpoint(scratch);
+	TextRun* live = arenaPush(scratch, sizeof(TextRun) * textCache.count);
+	isize liveCount = 0;
+	for(isize i = 0; i < TextCacheSlots; ++i) {
+		TextRun* run = textCache.runs + i;
+		if(run->hash && textCache.frame - run->lastUsed < TextCacheMaxAge) {
+			live[liveCount++] = *run;
 		}
+	}
+
+	textCache.current ^= 1;
+	arenaRewind(textCache.starts[textCache.current]);
+	memset(textCache.runs, 0, sizeof(textCache.runs));
+	textCache.count = 0;
+	textCache.used = 0;
+	for(isize i = 0; i < liveCount; ++i) {
+		textCacheStore(textCacheSlot(live[i].hash), live + i);
+	}
+	arenaRewind(cp);
+
+	// If most of it's live, collecting again next frame won't help
+	textCache.budget = TextCacheBudget;
+	if(textCache.used * 2 > textCache.budget) {
+		textCache.budget = textCache.used * 2;
+	}
+}
+
+/* Greedy line breaking. Each line takes as many glyphs as fit in width
+ * and ends after the last space or hyphen that fits; the space is 
+ * dropped. A word too long for a line on its own is broken where it runs
+ * out of room. Returns the line count; lines needs room for len + 1 */
+static
+isize textBreakLines(Spritefont* font, TextRun* run, TextLine* lines)
+{
+	string txt = run->text;
+	isize len = run->len;
+	isize count = 0;
+	isize start = 0;
+	while(1) {
+		f32 x = 0;
+		isize breakEnd = -1, breakNext = -1;
+		isize i = start;
+		for(; i < len; ++i) {
+			char c = txt[i];
+			if(c == '\n') break;
+			// Spaces can always end a line, so never overflow it
+			if(c == ' ') {
+				breakEnd = i;
+				breakNext = i + 1;
+			}
+			if(c < 32 || c > 128) continue;
+			f32 w = font->glyphs[c-32].w * run->scale;
+			if(run->width != TextNoWrap && c != ' ' && x + w > run->width) break;
+			x += w;
+			if(c == '-') {
+				breakEnd = i + 1;
+				breakNext = i + 1;
+			}
+		}
+
+		TextLine* line = lines + count++;
+		line->start = start;
+		if(i == len) {
+			line->end = len;
+			break;
+		} else if(txt[i] == '\n') {
+			line->end = i;
+			start = i + 1;
+		} else if(breakEnd > start) {
+			line->end = breakEnd;
+			start = breakNext;
+		} else {
+			// Always take at least one glyph, however narrow the width
+			line->end = i > start ? i : i + 1;
+			start = line->end;
+		}
+	}
+	return count;
+}
+
+/* Glyph c is font->glyphs[c - 32], which is also its index in a glyph
+ * table made from the font's rects */
+static
+void textLayout(Spritefont* font, TextRun* run)
+{
+	f32 scale = run->scale;
+	f32 lineH = (font->glyphs[1].h + 2) * scale;
+	isize count = 0;
+	f32 glyphScale = scale * WPL_GLYPH_SCALE;
+	i32 canGlyph = run->glyphs && glyphScale >= 1 && glyphScale <= 255 && 
+		glyphScale == (f32)(i32)glyphScale;
+	run->glyphMaxX = 0;
+	run->glyphMaxY = 0;
+	run->lineCount = textBreakLines(font, run, run->lines);
+	for(isize l = 0; l < run->lineCount; ++l) {
+		TextLine* line = run->lines + l;
+		f32 x = 0, y = l * lineH;
+		for(isize i = line->start; i < line->end; ++i) {
+			char c = run->text[i];
+			if(c < 32 || c > 128) continue;
+			Rect2i glyph = font->glyphs[c-32];
+			wplSprite* s = run->sprites + count++;
+			s->flags = Anchor_TopLeft | Sprite_NoAA;
+			s->color = 0xFFFFFFFF;
+			s->x = x;
+			s->y = y;
+			s->w = glyph.w * scale;
+			s->h = glyph.h * scale;
+			s->cx = 0;
+			s->cy = 0;
+			s->tx = glyph.x;
+			s->ty = glyph.y;
+			s->tw = glyph.w;
+			s->th = glyph.h;
+			s->angle = 0;
+			x += glyph.w * scale;
+
+			f32 gx = s->x * WPL_PACKED_UNIT, gy = s->y * WPL_PACKED_UNIT;
+			if(canGlyph && gx <= 32767 && gy <= 32767 && 
+					gx == (f32)(i32)gx && gy == (f32)(i32)gy) {
+				wplGlyphSprite* g = run->glyphs + count - 1;
+				g->x = (i16)gx;
+				g->y = (i16)gy;
+				g->glyph = (u8)(c - 32);
+				g->scale = (u8)glyphScale;
+				g->flags = (u16)s->flags;
+				g->color = s->color;
+				if(gx > run->glyphMaxX) run->glyphMaxX = (i32)gx;
+				if(gy > run->glyphMaxY) run->glyphMaxY = (i32)gy;
+			} else {
+				canGlyph = 0;
+			}
+		}
+	}
+	run->count = count;
+	if(!canGlyph) run->glyphs = NULL;
+	run->height = (run->lineCount - 1) * lineH + font->glyphs[1].h;
+}
+
+/* Finds txt's run, laying it out if it isn't cached. len can be -1 for 
+ * a null-terminated string; the run's len is the real one either way */
+TextRun* textRunGet(Spritefont* font, string txt, isize len, f32 scale, f32 width)
+{
+	if(!textCache.arenas[0]) {
+		for(isize i = 0; i < 2; ++i) {
+			textCache.arenas[i] = arenaBootstrap(gMemInfo, 0);
+			textCache.arenas[i]->name = "text cache";
+			textCache.starts[i] = arenaCheckpoint(textCache.arenas[i]);
+		}
+		textCache.budget = TextCacheBudget;
+	}
+
+	u64 hash = textHash(txt, &len, scale, width);
+	TextRun* run = textCacheSlot(hash);
+	if(run->hash == hash) {
+		if(run->len == len && run->scale == scale && run->width == width &&
+				memcmp(run->text, txt, len) == 0) {
+			run->lastUsed = textCache.frame;
+			textCache.hits++;
+			return run;
+		}
+		// A full 64 bit collision; the new string takes the slot
+	}
 
-		if(c < 32 || c > 128) continue;
-		Rect2i glyph = font->glyphs[c-32];
-		Vec2 fpos = v2Add(pos, initialPos);
+	textCache.misses++;
+	if(textCache.used > textCache.budget || 
+			textCache.count > TextCacheSlots * 3 / 4) {
+		textCacheCollect();
+		run = textCacheSlot(hash);
+	}
+
+	MemoryArena* scratch = arenaThreadScratch();
+	ArenaCheckpoint cp = arenaCheckpoint(scratch);
+	TextRun layout = {0};
+	layout.hash = hash;
+	layout.scale = scale;
+	layout.width = width;
+	layout.len = len;
+	layout.text = (char*)txt;
+	layout.lastUsed = textCache.frame;
+	layout.sprites = arenaPush(scratch, sizeof(wplSprite) * (len + 1));
+	layout.glyphs = arenaPush(scratch, sizeof(wplGlyphSprite) * (len + 1));
+	layout.lines = arenaPush(scratch, sizeof(TextLine) * (len + 1));
+	textLayout(font, &layout);
+	textCacheStore(run, &layout);
+	arenaRewind(cp);
+	return run;
+}
 
-		wplGroupAdd(group, Anchor_TopLeft | Sprite_NoAA,
-				fpos.x, fpos.y, glyph.w * scale, glyph.h * scale, 
-				glyph.x, glyph.y, glyph.w, glyph.h);
-		pos.x += glyph.w * scale;
+void textRunDraw(TextRun* run, wplRenderGroup* group, f32 x, f32 y)
+{
+	wplSprite* out = wplGroupAddSprites(group, run->count);
+	wplSprite* in = run->sprites;
+	for(isize i = 0; i < run->count; ++i) {
+		wplSprite s = in[i];
+		s.x += x;
+		s.y += y;
+		out[i] = s;
+	}
+
+	// If the offset is a whole number of packed units, the instances go
+	// along too, and the batch only has to copy them
+	if(run->glyphs && group->glyphs) {
+		f32 gx = x * WPL_PACKED_UNIT, gy = y * WPL_PACKED_UNIT;
+		if(gx >= -32768 && gx + run->glyphMaxX <= 32767 &&
+				gy >= -32768 && gy + run->glyphMaxY <= 32767 &&
+				gx == (f32)(i32)gx && gy == (f32)(i32)gy) {
+			wplGroupAttachGlyphs(group, run->glyphs, run->count, 
+					(i32)gx, (i32)gy);
+		}
 	}
 }
 
+void fontDrawText(Spritefont* font, wplRenderGroup* group, f32 x, f32 y, string txt, isize len, f32 scale, u32 color)
+{
+	textRunDraw(textRunGet(font, txt, len, scale, TextNoWrap), group, x, y);
+}
+
 int stringContains(string s, char c)
 {
 	int h = 0;
@@ -40,36 +360,28 @@ int stringContains(string s, char c)
 
 f32 fontDrawTextWrapped(Spritefont* font, wplRenderGroup* group, f32 x, f32 y, string txt, isize len, f32 scale, u32 color, f32 width)
 {
-	if(len == -1) len = strlen(txt);
-	Vec2 initialPos = v2(x, y);
-	Vec2 pos = v2(0, 0);
-	for(isize i = 0; i < len; ++i) {
-		char c = txt[i];
-		if(c == '\n') {
-			pos.x = 0;
-			pos.y += (font->glyphs[1].h + 2) * scale;
-		}
-
-		if((c == ' ' || c == '-') && (pos.x) > width) {
-			pos.x = 0;
-			pos.y += (font->glyphs[1].h + 2) * scale;
-			continue;
-		}
-
-		if(c < 32 || c > 128) continue;
-		Rect2i glyph = font->glyphs[c-32];
-		Vec2 fpos = v2Add(pos, initialPos);
+	TextRun* run = textRunGet(font, txt, len, scale, width);
+	textRunDraw(run, group, x, y);
+	return run->height;
+}
 
-		wplGroupAdd(group, Anchor_TopLeft | Sprite_NoAA,
-				fpos.x, fpos.y, glyph.w * scale, glyph.h * scale, 
-				glyph.x, glyph.y, glyph.w, glyph.h);
-		pos.x += glyph.w * scale;
-	}
-	pos.y += font->glyphs[1].h;
-	return pos.y;
+/* What fontDrawTextWrapped would return, without drawing; the layout is
+ * cached, so measuring and then drawing only breaks the lines once */
+f32 fontMeasureTextWrapped(Spritefont* font, string txt, isize len, f32 scale, f32 width)
+{
+	return textRunGet(font, txt, len, scale, width)->height;
 }
 
 wplRenderGroup* textGroup;
+wplBatch* frameBatch;
+
+enum DrawLayers
+{
+	Layer_Background,
+	Layer_World,
+	Layer_Text,
+	Layer_Overlay
+};
 
 isize sizeText(string s)
 {
@@ -86,6 +398,11 @@ f32 drawTextSW(f32 x, f32 y, string s, f32 scale, f32 w)
 	return fontDrawTextWrapped(&gameData.font, textGroup, x, y, s, -1, scale, 0xFFFFFFFF, w);
 }
 
+f32 measureTextSW(string s, f32 scale, f32 w)
+{
+	return fontMeasureTextWrapped(&gameData.font, s, -1, scale, w);
+}
+
 void drawTextS(f32 x, f32 y, string s, f32 scale)
 {
 	fontDrawText(&gameData.font, textGroup, x, y, s, -1, scale, 0xFFFFFFFF);
@@ -93,7 +410,8 @@ void drawTextS(f32 x, f32 y, string s, f32 scale)
 
 void drawTextR(f32 x, f32 y, string s)
 {
-	drawText(x - sizeText(s), y, s);
+	TextRun* run = textRunGet(&gameData.font, s, -1, 0.5, TextNoWrap);
+	textRunDraw(run, textGroup, x - run->len * gameData.font.glyphs[1].w / 2, y);
 }
 
 void getMouse(wplRenderGroup* group, f32* mx, f32* my)
@@ -102,25 +420,71 @@ void getMouse(wplRenderGroup* group, f32* mx, f32* my)
 	*my = mouseY / group->scale;
 }
 
+/* Hit testing. Widgets register their rect under an id as they're drawn,
+ * and the last one registered under the mouse (the one on top) is hot 
+ * for the next frame. Widgets that overlap no longer both take a click,
+ * and which one has the mouse is settled once, not by every widget. */
+enum UiKind
+{
+	Ui_Button,
+	Ui_ButtonL,
+	Ui_EventTab
+};
+
+struct UiState
+{
+	u64 hot, nextHot;
+} ui;
+
+u64 uiId(int kind, f32 x, f32 y)
+{
+	u32 bits[2];
+	memcpy(bits, &x, 4);
+	memcpy(bits + 1, &y, 4);
+	u64 id = 14695981039346656037ULL;
+	id = (id ^ (u64)kind) * 1099511628211ULL;
+	id = (id ^ bits[0]) * 1099511628211ULL;
+	id = (id ^ bits[1]) * 1099511628211ULL;
+	return id ? id : 1;
+}
+
+void uiNewFrame()
+{
+	ui.hot = ui.nextHot;
+	ui.nextHot = 0;
+}
+
+/* Returns whether the mouse is in the widget, and sets mouseState to 1
+ * while the button's held on it, 2 when it's released on it */
+int uiInteract(wplRenderGroup* group, u64 id, 
+		f32 x, f32 y, f32 w, f32 h, int* mouseState)
+{
+	*mouseState = 0;
+	f32 mx, my;
+	getMouse(group, &mx, &my);
+	if(!(mx > x && my > y && mx < (x + w) && my < (y + h))) return 0;
+	ui.nextHot = id;
+	if(ui.hot != id) return 0;
+	*mouseState = wplMouseIsDown(1);
+	if(!*mouseState) {
+		*mouseState = wplMouseIsJustUp(1) * 2;
+	}
+	return 1;
+}
+
 
 int uiButton(f32 x, f32 y, string msg)
 {
-	f32 c = strlen(msg) * gameData.font.glyphs[1].w;
+	TextRun* text = textRunGet(&gameData.font, msg, -1, 0.5, TextNoWrap);
+	f32 c = text->len * gameData.font.glyphs[1].w;
 	c *= 0.5;
 	c += 8;
 	f32 width = c < 48 ? 48 : c;
 	f32 height = 10;
 
-	int mouseIn = 0, mouseState = 0;
-	f32 mx, my;
-	getMouse(textGroup, &mx, &my);
-	if(mx > x && my > y && mx < (x + width) && my < (y + height)) {
-		mouseIn = 1;
-		mouseState = wplMouseIsDown(1);
-		if(!mouseState) {
-			mouseState = wplMouseIsJustUp(1) * 2;
-		}
-	}
+	int mouseState;
+	int mouseIn = uiInteract(textGroup, uiId(Ui_Button, x, y), 
+			x, y, width, height, &mouseState);
 
 	wplSprite* s = wplGetSprite(textGroup);
 	s->x = x;
@@ -138,29 +502,23 @@ int uiButton(f32 x, f32 y, string msg)
 		} 
 	}
 
-	drawText(x + 4, y + 2, msg);
+	textRunDraw(text, textGroup, x + 4, y + 2);
 	
 	return mouseIn && mouseState == 2;
 }
 
 int uiButtonL(f32 x, f32 y, string msg)
 {
-	f32 c = strlen(msg) * gameData.font.glyphs[1].w;
+	TextRun* text = textRunGet(&gameData.font, msg, -1, 0.5, TextNoWrap);
+	f32 c = text->len * gameData.font.glyphs[1].w;
 	c *= 0.5;
 	c += 8;
 	f32 width = c < 48 ? 48 : c;
 	f32 height = 10;
 
-	int mouseIn = 0, mouseState = 0;
-	f32 mx, my;
-	getMouse(textGroup, &mx, &my);
-	if(mx > x && my > y && mx < (x + width) && my < (y + height)) {
-		mouseIn = 1;
-		mouseState = wplMouseIsDown(1);
-		if(!mouseState) {
-			mouseState = wplMouseIsJustUp(1) * 2;
-		}
-	}
+	int mouseState;
+	int mouseIn = uiInteract(textGroup, uiId(Ui_ButtonL, x, y), 
+			x, y, width, height, &mouseState);
 
 	wplSprite* s = wplGetSprite(textGroup);
 	s->x = x;
@@ -178,8 +536,72 @@ int uiButtonL(f32 x, f32 y, string msg)
 		} 
 	}
 
-	drawText(x + 4, y + 2, msg);
+	textRunDraw(text, textGroup, x + 4, y + 2);
 	
 	return mouseIn && mouseState == 2;
 }
 
+/* F3 frame timing: a graph of the last WPL_PROFILE_HISTORY frames (GPU 
+ * time drawn over the frame time), then CPU and per-draw GPU costs */
+void drawProfileOverlay(wplWindow* window, wplState* state)
+{
+	wplProfile* p = wplGetProfile();
+	f32 x = 4, y = 4;
+	f32 graphH = 40, unitsPerMs = 1.2f;
+	f32 lineH = (gameData.font.glyphs[1].h + 2) * 0.5f;
+	// Wide enough for the longest line of text
+	f32 panelW = sizeText("platform 00.00  game 00.00  render 00.00") + 4;
+	f32 panelH = graphH + 4 + lineH * (4 + p->drawCount);
+	if(panelW < WPL_PROFILE_HISTORY + 4) panelW = WPL_PROFILE_HISTORY + 4;
+	// The overlay is drawn at its own scale; put the game's back after
+	f32 oldScale = textGroup->scale;
+	textGroup->scale = 2;
+
+	wplSprite* s = wplGroupAdd(textGroup, Sprite_NoTexture | Anchor_TopLeft,
+			x - 2, y - 2, panelW, panelH,
+			0, 0, 0, 0);
+	s->color = 0x000000BB;
+
+	for(isize i = 0; i < WPL_PROFILE_HISTORY; ++i) {
+		isize index = (p->historyHead + i) % WPL_PROFILE_HISTORY;
+		f32 frameH = p->history[index] * unitsPerMs;
+		f32 gpuH = p->gpuHistory[index] * unitsPerMs;
+		if(frameH > graphH) frameH = graphH;
+		if(gpuH > graphH) gpuH = graphH;
+
+		s = wplGroupAdd(textGroup, Sprite_NoTexture | Anchor_BottomLeft,
+				x + i, y + graphH, 1, frameH,
+				0, 0, 0, 0);
+		s->color = p->history[index] > 17 ? 0xFF4444FF : 0x44FF44FF;
+
+		s = wplGroupAdd(textGroup, Sprite_NoTexture | Anchor_BottomLeft,
+				x + i, y + graphH, 1, gpuH,
+				0, 0, 0, 0);
+		s->color = 0x4488FFFF;
+	}
+
+	// 60hz line
+	s = wplGroupAdd(textGroup, Sprite_NoTexture | Anchor_TopLeft,
+			x, y + graphH - 16.7f * unitsPerMs, WPL_PROFILE_HISTORY, 0.5f,
+			0, 0, 0, 0);
+	s->color = 0xFFFFFF88;
+
+	y += graphH + 2;
+	drawText(x, y, wplFramePrintf("frame %.2fms  gpu %.2fms", 
+				p->frameMs, p->gpuMs));
+	y += lineH;
+	drawText(x, y, wplFramePrintf("platform %.2f  game %.2f  render %.2f", 
+				p->platformMs, p->gameMs, p->renderMs));
+	y += lineH;
+	drawText(x, y, wplFramePrintf("%d draws", p->drawCount));
+	y += lineH;
+	for(isize i = 0; i < p->drawCount; ++i) {
+		wplDrawTiming* draw = p->draws + i;
+		drawText(x, y, wplFramePrintf("layer %2d %6d sprites %.3fms", 
+					draw->layer, (int)draw->sprites, draw->gpuMs));
+		y += lineH;
+	}
+
+	wplBatchSubmit(window, state, frameBatch, textGroup, Layer_Overlay);
+	textGroup->scale = oldScale;
+}
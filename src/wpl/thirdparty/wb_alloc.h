@@ -105,6 +105,37 @@
  * Whenever you call allocatorInit(allocator*, ...) we zero the pointer 
  * you give, unless this flag is set.
  *
+ * #define WB_ALLOC_SCRATCH_RESERVE CalcGigabytes(1)
+ * The amount of address space each thread's scratch arena reserves. See
+ * arenaThreadScratch below.
+ *
+ * #define WB_ALLOC_THREAD_LOCAL __declspec(thread) / __thread
+ * Storage class used for the per-thread scratch arena pointer.
+ *
+ * #define WB_ALLOC_RESET_THRESHOLD CalcKilobytes(256)
+ * #define WB_ALLOC_STREAM_THRESHOLD CalcKilobytes(32)
+ * #define WB_ALLOC_DECOMMIT_SLACK CalcMegabytes(16)
+ * Defaults for the MemoryInfo fields of the same names that getMemoryInfo
+ * hands out; see the comment on struct MemoryInfo.
+ *
+ * #define WB_ALLOC_NO_STREAMING_STORES
+ * Don't use SSE2 non-temporal stores to zero medium-sized regions, just
+ * memset them. Streaming stores are only used when the compiler says SSE2
+ * is available anyway.
+ *
+ * #define WB_ALLOC_STATS
+ * Turns on instrumentation: every arena, pool and tagged heap keeps current
+ * and peak usage, commit counts and alignment waste in its stats field, and
+ * allocations made through arenaPush/poolRetrieve/taggedAlloc are counted 
+ * per call site. See memoryStatsQuery and memoryStatsDumpJson. The stats
+ * field exists either way, so code built with and without this flag can be
+ * linked together. Needs stdio.h.
+ *
+ * #define WB_ALLOC_STATS_MAX_OBJECTS 128
+ * #define WB_ALLOC_STATS_MAX_CALLSITES 1024
+ * How many allocators and call sites the instrumentation can keep track of;
+ * the call site count must be a power of two.
+ *
  * #define WB_ALLOC_CPLUSPLUS_FEATURES
  * If you are using C++, there are some "features" of C that are not available,
  * first and foremost, automatic void* coercion to other pointer types. To save 
@@ -216,12 +247,109 @@ typedef isize isize;
 #define WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT 64
 #endif
 
+#ifndef WB_ALLOC_SCRATCH_RESERVE
+#define WB_ALLOC_SCRATCH_RESERVE CalcGigabytes(1)
+#endif
+
+#ifndef WB_ALLOC_RESET_THRESHOLD
+#define WB_ALLOC_RESET_THRESHOLD CalcKilobytes(256)
+#endif
+
+#ifndef WB_ALLOC_STREAM_THRESHOLD
+#define WB_ALLOC_STREAM_THRESHOLD CalcKilobytes(32)
+#endif
+
+#ifndef WB_ALLOC_DECOMMIT_SLACK
+#define WB_ALLOC_DECOMMIT_SLACK CalcMegabytes(16)
+#endif
+
+#ifndef WB_ALLOC_NO_STREAMING_STORES
+#if defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WB_ALLOC_STREAMING_STORES
+#endif
+#endif
+
+#ifndef WB_ALLOC_THREAD_LOCAL
+#ifdef _MSC_VER
+#define WB_ALLOC_THREAD_LOCAL __declspec(thread)
+#else
+#define WB_ALLOC_THREAD_LOCAL __thread
+#endif
+#endif
+
+/* NOTE: compare-and-swap is the only atomic the library really 
+ * needs; everything else (spin locks, the atomic arena head) is built out 
+ * of it. The atomic add is just for the stats counters. Both operate on 
+ * pointer-sized values.
+ */
+#ifdef _MSC_VER
+#ifdef __cplusplus
+extern "C"
+#endif
+long long _InterlockedCompareExchange64(long long volatile* dest, 
+		long long exchange, long long comparand);
+#pragma intrinsic(_InterlockedCompareExchange64)
+#ifdef __cplusplus
+extern "C"
+#endif
+long long _InterlockedExchangeAdd64(long long volatile* dest, 
+		long long value);
+#pragma intrinsic(_InterlockedExchangeAdd64)
+#define wbi__CompareAndSwap(ptr, expected, desired) \
+	(_InterlockedCompareExchange64((long long volatile*)(ptr), \
+		(long long)(desired), (long long)(expected)) == (long long)(expected))
+#define wbi__AtomicAdd(ptr, value) \
+	_InterlockedExchangeAdd64((long long volatile*)(ptr), (long long)(value))
+#ifdef _WIN64
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned char _BitScanForward64(unsigned long* index, 
+		unsigned long long mask);
+#pragma intrinsic(_BitScanForward64)
+#define wbi__BitScanForward(index, mask) _BitScanForward64(index, mask)
+#else
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned char _BitScanForward(unsigned long* index, unsigned long mask);
+#pragma intrinsic(_BitScanForward)
+#define wbi__BitScanForward(index, mask) _BitScanForward(index, mask)
+#endif
+#else
+#define wbi__CompareAndSwap(ptr, expected, desired) \
+	__sync_bool_compare_and_swap((isize volatile*)(ptr), \
+		(isize)(expected), (isize)(desired))
+#define wbi__AtomicAdd(ptr, value) \
+	__sync_fetch_and_add((isize volatile*)(ptr), (isize)(value))
+#endif
+
+#ifdef WB_ALLOC_STATS
+#ifndef WB_ALLOC_STATS_MAX_OBJECTS
+#define WB_ALLOC_STATS_MAX_OBJECTS 128
+#endif
+
+#ifndef WB_ALLOC_STATS_MAX_CALLSITES
+#define WB_ALLOC_STATS_MAX_CALLSITES 1024
+#endif
+#endif
+
+#define WB_ALLOC_STATS_HISTOGRAM_BUCKETS 16
+#define wbi__StatsArena 1
+#define wbi__StatsPool 2
+#define wbi__StatsTaggedHeap 3
+
 #define CalcKilobytes(x) (((usize)x) * 1024)
 #define CalcMegabytes(x) (CalcKilobytes((usize)x) * 1024)
 #define CalcGigabytes(x) (CalcMegabytes((usize)x) * 1024)
 
 typedef struct MemoryInfo MemoryInfo;
 typedef struct MemoryArena MemoryArena;
+typedef struct ArenaCheckpoint ArenaCheckpoint;
+typedef struct MemoryStats MemoryStats;
+typedef struct MemoryCallsite MemoryCallsite;
 typedef struct MemoryPool MemoryPool;
 typedef struct wbi__TaggedHeapArena wbi__TaggedHeapArena;
 typedef struct TaggedHeap TaggedHeap;
@@ -238,6 +366,7 @@ typedef void myhandle;
 #define FlagArenaExtended 4
 #define FlagArenaNoZeroMemory 8
 #define FlagArenaNoRecommit 16 
+#define FlagArenaAtomic 32
 
 #define FlagPoolNormal 0
 #define FlagPoolFixedSize 1
@@ -254,10 +383,46 @@ typedef void myhandle;
 
 /* Struct Definitions */
 
+/* The last three fields are the zeroing/decommit policy for anything 
+ * allocated with this info. When memory is given back (arenaPop, 
+ * arenaRewind, arenaEndTemp, arenaClear, taggedFree):
+ * 	- regions of at least resetThreshold bytes have their whole pages handed
+ * 	back to the OS, which gives us zero pages the next time they're touched
+ * 	- regions of at least streamThreshold bytes are zeroed with non-temporal
+ * 	stores, so we don't blow the cache out on memory nobody is about to read
+ * 	- everything else gets a memset
+ * and if an arena has more than decommitSlack bytes committed past its 
+ * head, it decommits back down to half that. Zero turns any of these off.
+ */
 struct MemoryInfo
 {
 	usize totalMemory, commitSize, pageSize;
 	isize commitFlags;
+	usize resetThreshold, streamThreshold, decommitSlack;
+};
+
+/* Only filled in with WB_ALLOC_STATS. used/committed are in bytes; for a
+ * pool, used is count * elementSize, and for a tagged heap committed is the
+ * size of the arenas it has checked out of its pool.
+ */
+struct MemoryStats
+{
+	usize used, peakUsed;
+	usize committed, peakCommitted;
+	usize alignmentWaste;
+	usize allocations, frees, commits;
+};
+
+/* Histogram bucket 0 counts allocations under 16 bytes, bucket n counts
+ * [16 << (n-1), 16 << n), and the last bucket counts everything larger.
+ */
+struct MemoryCallsite
+{
+	usize key;
+	const char* file;
+	isize line;
+	usize count, bytes;
+	usize histogram[WB_ALLOC_STATS_HISTOGRAM_BUCKETS];
 };
 
 struct MemoryArena
@@ -268,6 +433,14 @@ struct MemoryArena
 	MemoryInfo info;
 	isize align;
 	isize flags;
+	isize commitLock;
+	MemoryStats stats;
+};
+
+struct ArenaCheckpoint
+{
+	MemoryArena* arena;
+	void* head;
 };
 
 struct MemoryPool
@@ -280,6 +453,12 @@ struct MemoryPool
 	MemoryArena* alloc;
 	isize lastFilled;
 	isize flags;
+	MemoryStats stats;
+
+	/* One bit per slot, set while the slot is handed out */
+	usize* occupied;
+	isize occupiedWords;
+	MemoryArena* occupiedAlloc;
 };
 
 struct wbi__TaggedHeapArena
@@ -298,6 +477,7 @@ struct TaggedHeap
 	MemoryInfo info;
 	usize arenaSize, align;
 	isize flags;
+	MemoryStats stats;
 };
 
 /* Function Prototypes */
@@ -320,25 +500,77 @@ void* arenaPushEx(MemoryArena* arena,
 WB_ALLOC_API 
 void* arenaPush(MemoryArena* arena, isize size);
 
+/* Arenas created with the ArenaAtomic flag may be pushed to from any number 
+ * of threads at once. The head is bumped with a compare-and-swap, so pushes
+ * that fit in the memory that's already committed never block. When the
+ * arena needs to grow, one thread takes the commit lock and commits more
+ * while everyone else keeps allocating out of what's already there.
+ *
+ * Atomic arenas are append-only: they can't be combined with ArenaStack or
+ * ArenaExtended, and rewinding/clearing them is only safe when no other 
+ * thread is pushing. arenaPush on an atomic arena calls this for you.
+ */
+WB_ALLOC_API
+void* arenaPushAtomic(MemoryArena* arena, isize size);
+
+/* arenaCheckpoint remembers the current head of an arena; arenaRewind 
+ * throws away everything pushed since then (zeroing it, unless the arena 
+ * has ArenaNoZeroMemory). Checkpoints nest like a stack.
+ *
+ * arenaThreadScratch returns an arena private to the calling thread,
+ * creating it the first time it's asked for. Use it with checkpoints for
+ * temporary allocations on worker threads:
+ *
+ * 	ArenaCheckpoint cp = arenaCheckpoint(arenaThreadScratch());
+ * 	...
+ * 	arenaRewind(cp);
+ *
+ * arenaThreadScratchRelease gives the calling thread's scratch arena back 
+ * to the OS; call it before a worker thread exits.
+ */
+WB_ALLOC_API
+ArenaCheckpoint arenaCheckpoint(MemoryArena* arena);
+WB_ALLOC_API
+void arenaRewind(ArenaCheckpoint checkpoint);
+WB_ALLOC_API
+MemoryArena* arenaThreadScratch(void);
+WB_ALLOC_API
+void arenaThreadScratchRelease(void);
+
 /* poolRetrieve gets the next element out of the pool. If the pool hasn't
  * been used yet, it simply pulls the next item out at the correct location.
  * Otherwise, it checks a free list of empty slots.
  *
  * poolRelease attaches the pointer to the free list. By default, it also
- * checks whether the pointer is already on the free list, to help prevent
- * double-free bugs. Use the PoolNoDoubleFreeCheck flag to disable this.
+ * checks the pool's occupancy bitmap to make sure the pointer is a live slot
+ * of this pool, to help prevent double-free bugs. Use the 
+ * PoolNoDoubleFreeCheck flag to disable this.
  *
  * If your pool is compacting (PoolCompacting flag), poolRelease will instead
  * copy the last element of the pool into the slot pointed at by ptr.
- * TODO(will): uh, maybe do some safety checks there...
  * This means that you can treat the pool's slots field as an array of your
  * struct/union and iterate over it without expecting holes; however, any 
  * retrieve/release operations can invalidate your pointers
+ *
+ * poolRetrieveN and poolReleaseN do the same for count elements at a time;
+ * poolRetrieveN returns how many it actually got, which is only less than
+ * count if a fixed-size pool runs out.
+ *
+ * poolIterNext walks the live slots of the pool in address order. Start 
+ * with index = 0; it returns NULL when there are no more. Releasing the
+ * slot you were just given is fine, retrieving while iterating may or may
+ * not show you the new slot.
  */
 WB_ALLOC_API 
 void* poolRetrieve(MemoryPool* pool);
 WB_ALLOC_API 
 void poolRelease(MemoryPool* pool, void* ptr);
+WB_ALLOC_API 
+isize poolRetrieveN(MemoryPool* pool, void** out, isize count);
+WB_ALLOC_API 
+void poolReleaseN(MemoryPool* pool, void** ptrs, isize count);
+WB_ALLOC_API 
+void* poolIterNext(MemoryPool* pool, isize* index);
 
 /* taggedAlloc behaves much like arenaPush, returning a pointer to a segment
  * of memory that is safe to write to. However, you cannot allocate more than
@@ -367,6 +599,8 @@ WB_ALLOC_BACKEND_API void* wbi__allocateVirtualSpace(usize size);
 WB_ALLOC_BACKEND_API void* wbi__commitMemory(void* addr, usize size, 
 		isize flags);
 WB_ALLOC_BACKEND_API void wbi__decommitMemory(void* addr, usize size);
+WB_ALLOC_BACKEND_API void wbi__resetMemory(void* addr, usize size, 
+		isize flags);
 WB_ALLOC_BACKEND_API void wbi__freeAddressSpace(void* addr, usize size);
 WB_ALLOC_API MemoryInfo getMemoryInfo();
 
@@ -398,6 +632,15 @@ void arenaEndTemp(MemoryArena* arena);
 
 WB_ALLOC_API 
 void arenaClear(MemoryArena* arena);
+
+/* arenaTrim decommits everything past the head of the arena beyond 
+ * info.decommitSlack / 2, if there's more than info.decommitSlack of it. 
+ * The functions that give memory back already call it; it's exposed so
+ * you can tighten things up after changing the policy. Fixed-size, atomic
+ * and NoRecommit arenas are left alone.
+ */
+WB_ALLOC_API 
+void arenaTrim(MemoryArena* arena);
 WB_ALLOC_API 
 void arenaDestroy(MemoryArena* arena);
 
@@ -451,6 +694,50 @@ void wbi__taggedArenaInit(TaggedHeap* heap,
 WB_ALLOC_API 
 void wbi__taggedArenaSortBySize(wbi__TaggedHeapArena** array, isize count);
 
+WB_ALLOC_API
+void wbi__spinLock(isize* lock);
+WB_ALLOC_API
+void wbi__spinUnlock(isize* lock);
+
+#ifdef WB_ALLOC_STATS
+/* memoryStatsQuery adds up the stats of every arena, pool and tagged heap
+ * whose name field matches name (so give the ones you care about names),
+ * and returns how many it found.
+ *
+ * memoryStatsDumpJson writes every tracked allocator and call site to
+ * filename as JSON, returning 0 if the file couldn't be opened.
+ *
+ * The *At functions are what arenaPush, poolRetrieve and taggedAlloc turn 
+ * into when WB_ALLOC_STATS is on; they record file/line as the call site.
+ */
+WB_ALLOC_API
+isize memoryStatsQuery(const char* name, MemoryStats* out);
+WB_ALLOC_API
+isize memoryStatsDumpJson(const char* filename);
+
+WB_ALLOC_API
+void* arenaPushAt(MemoryArena* arena, isize size, 
+		const char* file, isize line);
+WB_ALLOC_API
+void* poolRetrieveAt(MemoryPool* pool, const char* file, isize line);
+WB_ALLOC_API
+void* taggedAllocAt(TaggedHeap* heap, isize tag, usize size, 
+		const char* file, isize line);
+
+WB_ALLOC_API
+void wbi__statsRegister(isize kind, void* object);
+WB_ALLOC_API
+void wbi__statsMove(void* from, void* to);
+WB_ALLOC_API
+void wbi__statsUnregister(void* object);
+WB_ALLOC_API
+void wbi__statsSetUsed(MemoryStats* stats, usize used);
+WB_ALLOC_API
+void wbi__statsSetCommitted(MemoryStats* stats, usize committed);
+WB_ALLOC_API
+void wbi__statsCallsite(const char* file, isize line, usize size);
+#endif
+
 
 /* Platform-Specific Code */
 
@@ -583,6 +870,15 @@ void wbi__decommitMemory(void* addr, usize size)
 {
     VirtualFree((void*)addr, size, MEM_DECOMMIT);
 }
+
+WB_ALLOC_BACKEND_API
+void wbi__resetMemory(void* addr, usize size, isize flags)
+{
+	/* NOTE: MEM_RESET doesn't promise zeroes, so we go through a
+	 * decommit; the recommit is free until the pages get touched */
+	wbi__decommitMemory(addr, size);
+	wbi__commitMemory(addr, size, flags);
+}
  
 WB_ALLOC_BACKEND_API
 void wbi__freeAddressSpace(void* addr, usize size)
@@ -616,6 +912,9 @@ MemoryInfo getMemoryInfo()
 	info.commitSize = CalcMegabytes(1);
 	info.pageSize = pageSize;
 	info.commitFlags = Read | Write;
+	info.resetThreshold = WB_ALLOC_RESET_THRESHOLD;
+	info.streamThreshold = WB_ALLOC_STREAM_THRESHOLD;
+	info.decommitSlack = WB_ALLOC_DECOMMIT_SLACK;
 	return info;
 
 }
@@ -638,6 +937,10 @@ MemoryInfo getMemoryInfo()
 #define MS_INVALIDATE 2
 #endif
 
+#ifndef MADV_DONTNEED
+#define MADV_DONTNEED 4
+#endif
+
 #ifndef _SC_PAGESIZE
 #define _SC_PAGESIZE 30
 #endif
@@ -737,6 +1040,10 @@ wbi__SystemExtern
 int munmap(void* addr, usize len);
 wbi__SystemExtern
 int msync(void* addr, usize len, int flags);
+#ifndef __APPLE__
+wbi__SystemExtern
+int madvise(void* addr, usize len, int advice);
+#endif
 wbi__SystemExtern
 long sysconf(int name);
 
@@ -752,7 +1059,7 @@ void* wbi__allocateVirtualSpace(usize size)
 WB_ALLOC_BACKEND_API
 void* wbi__commitMemory(void* addr, usize size, isize flags)
 {
-    void * ptr = mmap(addr, size, flags, MAP_FIXED|MAP_SHARED|MAP_ANON, -1, 0);
+    void * ptr = mmap(addr, size, flags, MAP_FIXED|MAP_PRIVATE|MAP_ANON, -1, 0);
     msync(addr, size, MS_SYNC|MS_INVALIDATE);
     return ptr;
 }
@@ -763,6 +1070,22 @@ void wbi__decommitMemory(void* addr, usize size)
     mmap(addr, size, PROT_NONE, MAP_FIXED|MAP_PRIVATE|MAP_ANON, -1, 0);
     msync(addr, size, MS_SYNC|MS_INVALIDATE);
 }
+
+WB_ALLOC_BACKEND_API
+void wbi__resetMemory(void* addr, usize size, isize flags)
+{
+	/* NOTE: on Linux, MADV_DONTNEED on a private anonymous mapping
+	 * drops the pages and gives back zero-fill-on-demand ones, which is 
+	 * exactly what we want (and why commits are MAP_PRIVATE). macOS only
+	 * treats it as a hint, so there we map fresh pages over the top. */
+#ifdef __APPLE__
+	mmap(addr, size, flags, MAP_FIXED|MAP_PRIVATE|MAP_ANON, -1, 0);
+#else
+	usize clangWouldWarnYouAboutThis = flags;
+	clangWouldWarnYouAboutThis++;
+	madvise(addr, size, MADV_DONTNEED);
+#endif
+}
  
 WB_ALLOC_BACKEND_API
 void wbi__freeAddressSpace(void* addr, usize size)
@@ -785,6 +1108,9 @@ MemoryInfo getMemoryInfo()
 	info.commitSize = CalcMegabytes(1);
 	info.pageSize = pageSize;
 	info.commitFlags = Read | Write;
+	info.resetThreshold = WB_ALLOC_RESET_THRESHOLD;
+	info.streamThreshold = WB_ALLOC_STREAM_THRESHOLD;
+	info.decommitSlack = WB_ALLOC_DECOMMIT_SLACK;
 	return info;
 
 }
@@ -805,6 +1131,81 @@ isize alignTo(usize x, usize align)
 	return mod ? x + (align - mod) : x;
 }
 
+/* Zeroing policy */
+
+static
+void wbi__streamZero(void* addr, usize size)
+{
+#ifdef WB_ALLOC_STREAMING_STORES
+	char *p, *end;
+	usize head;
+	__m128i zero;
+
+	p = (char*)addr;
+	end = p + size;
+	head = alignTo((usize)p, 16) - (usize)p;
+	WB_ALLOC_MEMSET(p, 0, head);
+	p += head;
+
+	zero = _mm_setzero_si128();
+	while(p + 64 <= end) {
+		_mm_stream_si128((__m128i*)p, zero);
+		_mm_stream_si128((__m128i*)(p + 16), zero);
+		_mm_stream_si128((__m128i*)(p + 32), zero);
+		_mm_stream_si128((__m128i*)(p + 48), zero);
+		p += 64;
+	}
+	_mm_sfence();
+	WB_ALLOC_MEMSET(p, 0, end - p);
+#else
+	WB_ALLOC_MEMSET(addr, 0, size);
+#endif
+}
+
+/* NOTE: canReset is false for memory we don't own the pages of
+ * (fixed-size buffers) or that the user asked us not to recommit */
+static
+void wbi__zeroMemory(MemoryInfo* info, void* addr, usize size, isize canReset)
+{
+	usize start, end;
+	if(canReset && info->resetThreshold && size >= info->resetThreshold) {
+		start = alignTo((usize)addr, info->pageSize);
+		end = ((usize)addr + size) & ~(info->pageSize - 1);
+		if(end > start) {
+			wbi__zeroMemory(info, addr, start - (usize)addr, 0);
+			wbi__resetMemory((void*)start, end - start, info->commitFlags);
+			wbi__zeroMemory(info, (void*)end, (usize)addr + size - end, 0);
+			return;
+		}
+	}
+
+	if(info->streamThreshold && size >= info->streamThreshold) {
+		wbi__streamZero(addr, size);
+		return;
+	}
+
+	if(size) {
+		WB_ALLOC_MEMSET(addr, 0, size);
+	}
+}
+
+/* Gives [from, to) back after the arena's head has been moved down to from;
+ * trims the commit and zeroes whatever is still committed */
+static
+void wbi__arenaReclaim(MemoryArena* arena, void* from, void* to)
+{
+	isize canReset = !(arena->flags & 
+			(FlagArenaFixedSize | FlagArenaNoRecommit));
+	arenaTrim(arena);
+	if((usize)to > (usize)arena->end) {
+		to = arena->end;
+	}
+
+	if(arena->flags & FlagArenaNoZeroMemory) return;
+	if((usize)to <= (usize)from) return;
+	wbi__zeroMemory(&arena->info, from, (usize)to - (usize)from, canReset);
+}
+
 /* Memory Arena */
 
 WB_ALLOC_API 
@@ -824,8 +1225,16 @@ void arenaFixedSizeInit(MemoryArena* arena,
 	arena->start = buffer;
 	arena->head = buffer;
 	arena->end = (void*)((isize)arena->start + size);
+	arena->info.resetThreshold = 0;
+	arena->info.streamThreshold = WB_ALLOC_STREAM_THRESHOLD;
+	arena->info.decommitSlack = 0;
 	arena->tempStart = NULL;
 	arena->tempHead = NULL;
+
+#ifdef WB_ALLOC_STATS
+	wbi__statsSetCommitted(&arena->stats, size);
+	wbi__statsRegister(wbi__StatsArena, arena);
+#endif
 }
 
 
@@ -845,6 +1254,14 @@ void arenaInit(MemoryArena* arena, MemoryInfo info, isize flags)
 				arena, "arena");
 		return;
 	}
+
+	if((flags & FlagArenaAtomic) && 
+			(flags & (FlagArenaStack | FlagArenaExtended))) {
+		WB_ALLOC_ERROR_HANDLER(
+				"atomic arenas can't be stack or extended arenas",
+				arena, "arena");
+		return;
+	}
 #endif
 
 	arena->flags = flags;
@@ -864,6 +1281,11 @@ void arenaInit(MemoryArena* arena, MemoryInfo info, isize flags)
 	arena->tempStart = NULL;
 	arena->tempHead = NULL;
 	arena->align = 8;
+
+#ifdef WB_ALLOC_STATS
+	wbi__statsSetCommitted(&arena->stats, info.commitSize);
+	wbi__statsRegister(wbi__StatsArena, arena);
+#endif
 }
 
 WB_ALLOC_API 
@@ -872,6 +1294,13 @@ void* arenaPushEx(MemoryArena* arena, isize size,
 {
 	void *oldHead, *ret;
 	usize newHead, toExpand;
+#ifdef WB_ALLOC_STATS
+	isize requested = size;
+#endif
+
+	if(arena->flags & FlagArenaAtomic) {
+		return arenaPushAtomic(arena, size);
+	}
 
 	if(arena->flags & FlagArenaStack) {
 		size += sizeof(WB_ALLOC_STACK_PTR);
@@ -900,6 +1329,11 @@ void* arenaPushEx(MemoryArena* arena, isize size,
 			return NULL;
 		}
 		arena->end = (char*)arena->end + toExpand;
+#ifdef WB_ALLOC_STATS
+		arena->stats.commits++;
+		wbi__statsSetCommitted(&arena->stats, 
+				(isize)arena->end - (isize)arena->start);
+#endif
 	}
 
 	if(arena->flags & FlagArenaStack) {
@@ -920,6 +1354,15 @@ void* arenaPushEx(MemoryArena* arena, isize size,
 
 	arena->head = (void*)newHead;
 
+#ifdef WB_ALLOC_STATS
+	arena->stats.allocations++;
+	arena->stats.alignmentWaste += newHead - (usize)oldHead - requested;
+	if(arena->flags & FlagArenaExtended) {
+		arena->stats.alignmentWaste += sizeof(WB_ALLOC_EXTENDED_INFO);
+	}
+	wbi__statsSetUsed(&arena->stats, newHead - (usize)arena->start);
+#endif
+
 	return oldHead;
 }
 
@@ -929,6 +1372,139 @@ void* arenaPush(MemoryArena* arena, isize size)
 	return arenaPushEx(arena, size, 0);
 }
 
+WB_ALLOC_API
+void wbi__spinLock(isize* lock)
+{
+	while(!wbi__CompareAndSwap(lock, 0, 1)) {
+		while(*(isize volatile*)lock);
+	}
+}
+
+WB_ALLOC_API
+void wbi__spinUnlock(isize* lock)
+{
+	wbi__CompareAndSwap(lock, 1, 0);
+}
+
+WB_ALLOC_API
+void* arenaPushAtomic(MemoryArena* arena, isize size)
+{
+	usize oldHead, newHead, end, toExpand;
+	void* ret;
+
+	for(;;) {
+		oldHead = (usize)*(void* volatile*)&arena->head;
+		newHead = alignTo(oldHead + size, arena->align);
+		end = (usize)*(void* volatile*)&arena->end;
+
+		if(newHead <= end) {
+			if(wbi__CompareAndSwap(&arena->head, oldHead, newHead)) {
+#ifdef WB_ALLOC_STATS
+				wbi__AtomicAdd(&arena->stats.allocations, 1);
+				wbi__AtomicAdd(&arena->stats.alignmentWaste, 
+						newHead - oldHead - size);
+				wbi__statsSetUsed(&arena->stats, 
+						newHead - (usize)arena->start);
+#endif
+				return (void*)oldHead;
+			}
+			continue;
+		}
+
+		if(arena->flags & FlagArenaFixedSize) {
+			WB_ALLOC_ERROR_HANDLER(
+					"ran out of memory",
+					arena, arena->name);
+			return NULL;
+		}
+
+		/* NOTE: whoever gets the lock commits enough for their own
+		 * push; anyone who was waiting on it re-checks end first, so we
+		 * only commit once per overflow. Publishing end with a CAS makes
+		 * sure the commit is visible before anyone bumps into it.
+		 */
+		wbi__spinLock(&arena->commitLock);
+		end = (usize)*(void* volatile*)&arena->end;
+		if(newHead > end) {
+			toExpand = alignTo(newHead - end, arena->info.commitSize);
+			ret = wbi__commitMemory((void*)end, toExpand, 
+					arena->info.commitFlags);
+			if(!ret) {
+				wbi__spinUnlock(&arena->commitLock);
+				WB_ALLOC_ERROR_HANDLER("failed to commit memory in "
+						"arenaPushAtomic",
+						arena, arena->name);
+				return NULL;
+			}
+			wbi__CompareAndSwap(&arena->end, end, end + toExpand);
+#ifdef WB_ALLOC_STATS
+			arena->stats.commits++;
+			wbi__statsSetCommitted(&arena->stats, 
+					end + toExpand - (usize)arena->start);
+#endif
+		}
+		wbi__spinUnlock(&arena->commitLock);
+	}
+}
+
+WB_ALLOC_API
+ArenaCheckpoint arenaCheckpoint(MemoryArena* arena)
+{
+	ArenaCheckpoint checkpoint;
+	checkpoint.arena = arena;
+	checkpoint.head = arena->head;
+	return checkpoint;
+}
+
+WB_ALLOC_API
+void arenaRewind(ArenaCheckpoint checkpoint)
+{
+	MemoryArena* arena = checkpoint.arena;
+	isize size = (isize)arena->head - (isize)checkpoint.head;
+	if(size < 0) {
+		WB_ALLOC_ERROR_HANDLER("tried to rewind an arena past its head",
+				arena, arena->name);
+		return;
+	}
+
+	arena->head = checkpoint.head;
+	if(size > 0) {
+		wbi__arenaReclaim(arena, checkpoint.head, 
+				(char*)checkpoint.head + size);
+	}
+#ifdef WB_ALLOC_STATS
+	arena->stats.frees++;
+	wbi__statsSetUsed(&arena->stats, 
+			(isize)arena->head - (isize)arena->start);
+#endif
+}
+
+static WB_ALLOC_THREAD_LOCAL MemoryArena* wbi__threadScratch;
+
+WB_ALLOC_API
+MemoryArena* arenaThreadScratch(void)
+{
+	MemoryInfo info;
+	if(!wbi__threadScratch) {
+		info = getMemoryInfo();
+		info.totalMemory = WB_ALLOC_SCRATCH_RESERVE;
+		wbi__threadScratch = arenaBootstrap(info, FlagArenaNormal);
+		if(wbi__threadScratch) {
+			wbi__threadScratch->name = "scratch";
+		}
+	}
+	return wbi__threadScratch;
+}
+
+WB_ALLOC_API
+void arenaThreadScratchRelease(void)
+{
+	if(wbi__threadScratch) {
+		arenaDestroy(wbi__threadScratch);
+		wbi__threadScratch = NULL;
+	}
+}
+
 WB_ALLOC_API 
 void arenaPop(MemoryArena* arena)
 {
@@ -948,18 +1524,21 @@ void arenaPop(MemoryArena* arena)
 	newHead = (void*)(*(WB_ALLOC_STACK_PTR*)prevHeadPtr);
 	if((isize)newHead <= (isize)arena->start) {
 		arena->head = arena->start;
+#ifdef WB_ALLOC_STATS
+		arena->stats.frees++;
+		wbi__statsSetUsed(&arena->stats, 0);
+#endif
 		return;
 	}
 
-	if(!(arena->flags & FlagArenaNoZeroMemory)) {
-		usize size;
-		size = (isize)arena->head - (isize)newHead;
-		if(size > 0) {
-			WB_ALLOC_MEMSET(newHead, 0, size);
-		}
-	}
-
+	prevHeadPtr = (usize)arena->head;
 	arena->head = newHead;
+	wbi__arenaReclaim(arena, newHead, (void*)prevHeadPtr);
+#ifdef WB_ALLOC_STATS
+	arena->stats.frees++;
+	wbi__statsSetUsed(&arena->stats, 
+			(isize)arena->head - (isize)arena->start);
+#endif
 }
 
 WB_ALLOC_API 
@@ -980,6 +1559,9 @@ MemoryArena* arenaBootstrap(MemoryInfo info, isize flags)
 	strapped = (MemoryArena*)
 		arenaPush(&arena, sizeof(MemoryArena) + 16);
 	*strapped = arena;
+#ifdef WB_ALLOC_STATS
+	wbi__statsMove(&arena, strapped);
+#endif
 	if(flags & FlagArenaStack) {
 		arenaPushEx(strapped, 0, 0);
 		*((WB_ALLOC_STACK_PTR*)(strapped->head) - 1) = 
@@ -998,6 +1580,9 @@ MemoryArena* arenaFixedSizeBootstrap(void* buffer, usize size,
 	strapped = (MemoryArena*)
 		arenaPush(&arena, sizeof(MemoryArena) + 16);
 	*strapped = arena;
+#ifdef WB_ALLOC_STATS
+	wbi__statsMove(&arena, strapped);
+#endif
 	if(flags & FlagArenaStack) {
 		arenaPushEx(strapped, 0, 0);
 		*((WB_ALLOC_STACK_PTR*)(strapped->head) - 1) = 
@@ -1020,50 +1605,207 @@ WB_ALLOC_API
 void arenaEndTemp(MemoryArena* arena)
 {
 	isize size;
+	void* tempEnd;
 	if(!arena->tempStart) return;
-	arena->head = (void*)alignTo((isize)arena->head, arena->info.pageSize);
+	tempEnd = (void*)alignTo((isize)arena->head, arena->info.pageSize);
 	size = (isize)arena->head - (isize)arena->tempStart;
+	arena->head = arena->tempHead;
 
 	/* NOTE(will): if you have an arena with flags 
 	 * 	ArenaNoRecommit | ArenaNoZeroMemory
 	 * This just moves the pointer, which might be something you want to do.
+	 * Otherwise, the temp region's pages always go back to the OS, and if
+	 * it grew the arena a lot, the commit gets trimmed too.
 	 */
 	if(!(arena->flags & FlagArenaNoRecommit)) {
-		wbi__decommitMemory(arena->tempStart, size);
-		wbi__commitMemory(arena->tempStart, size, arena->info.commitFlags);
+		arenaTrim(arena);
+		if((usize)tempEnd > (usize)arena->end) {
+			tempEnd = arena->end;
+		}
+		if((usize)tempEnd > (usize)arena->tempStart) {
+			wbi__resetMemory(arena->tempStart, 
+					(isize)tempEnd - (isize)arena->tempStart,
+					arena->info.commitFlags);
+		}
 	} else if(!(arena->flags & FlagArenaNoZeroMemory)) {
-		WB_ALLOC_MEMSET(arena->tempStart, 0,
-				(isize)arena->head - (isize)arena->tempStart);
+		wbi__zeroMemory(&arena->info, arena->tempStart, size, 0);
 	}
 
-	arena->head = arena->tempHead;
 	arena->tempHead = NULL;
 	arena->tempStart = NULL;
+#ifdef WB_ALLOC_STATS
+	arena->stats.frees++;
+	wbi__statsSetUsed(&arena->stats, 
+			(isize)arena->head - (isize)arena->start);
+#endif
 }
 
 WB_ALLOC_API 
 void arenaClear(MemoryArena* arena)
 {
-	MemoryArena local = *arena;
-	isize size = (isize)arena->end - (isize)arena->start;
-	wbi__decommitMemory(local.start, size);
-	wbi__commitMemory(local.start, size, local.info.commitFlags);
+	MemoryArena local;
+	isize size;
+	arenaTrim(arena);
+	local = *arena;
+	size = (isize)arena->end - (isize)arena->start;
+	if(arena->flags & FlagArenaFixedSize) {
+		wbi__zeroMemory(&local.info, local.start, size, 0);
+	} else {
+		wbi__resetMemory(local.start, size, local.info.commitFlags);
+	}
 	*arena = local;
 }
 
+WB_ALLOC_API
+void arenaTrim(MemoryArena* arena)
+{
+	usize end, newEnd;
+	if(arena->flags & 
+			(FlagArenaFixedSize | FlagArenaAtomic | FlagArenaNoRecommit)) {
+		return;
+	}
+
+	end = (usize)arena->end;
+	if(!arena->info.decommitSlack || 
+			end - (usize)arena->head <= arena->info.decommitSlack) {
+		return;
+	}
+
+	/* NOTE: the arena always commits in multiples of commitSize from
+	 * start, so keep it that way */
+	newEnd = (usize)arena->start + alignTo(
+			(usize)arena->head - (usize)arena->start + 
+			arena->info.decommitSlack / 2,
+			arena->info.commitSize);
+	if(newEnd >= end) return;
+
+	wbi__decommitMemory((void*)newEnd, end - newEnd);
+	arena->end = (void*)newEnd;
+#ifdef WB_ALLOC_STATS
+	wbi__statsSetCommitted(&arena->stats, newEnd - (usize)arena->start);
+#endif
+}
+
 WB_ALLOC_API
 void arenaDestroy(MemoryArena* arena)
 {
-	wbi__freeAddressSpace(arena->start, 
-			(isize)arena->end - (isize)arena->start);
+	/* NOTE: munmap wants the whole reservation back, not just the
+	 * part we committed. Fixed-size arenas don't own their buffer. */
+#ifdef WB_ALLOC_STATS
+	wbi__statsUnregister(arena);
+#endif
+	if(arena->flags & FlagArenaFixedSize) return;
+	wbi__freeAddressSpace(arena->start, arena->info.totalMemory);
 }
 
 /* Memory Pool */
+
+/* NOTE: pools living in a fixed-size arena carve their occupancy 
+ * bitmap off the front of the buffer. Growable pools get a separate arena 
+ * for it, reserved big enough to cover every slot the backing arena could 
+ * ever commit, and commit words as the pool grows.
+ */
+#define wbi__WordBits ((isize)sizeof(usize) * 8)
+
+static
+isize wbi__countTrailingZeros(usize x)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	wbi__BitScanForward(&index, x);
+	return (isize)index;
+#else
+	return (isize)__builtin_ctzll((unsigned long long)x);
+#endif
+}
+
+static
+void wbi__poolSetBits(MemoryPool* pool, isize start, isize count)
+{
+	isize bit, n, end = start + count;
+	usize mask;
+	while(start < end) {
+		bit = start % wbi__WordBits;
+		n = wbi__WordBits - bit;
+		if(n > end - start) n = end - start;
+		mask = n == wbi__WordBits ? 
+			~(usize)0 : 
+			(((usize)1 << n) - 1) << bit;
+		pool->occupied[start / wbi__WordBits] |= mask;
+		start += n;
+	}
+}
+
+static
+isize wbi__poolReserveOccupancy(MemoryPool* pool)
+{
+	isize words = (pool->capacity + wbi__WordBits - 1) / wbi__WordBits;
+	if(words <= pool->occupiedWords) return 1;
+
+	if(!pool->occupiedAlloc || !arenaPush(pool->occupiedAlloc, 
+				(words - pool->occupiedWords) * sizeof(usize))) {
+		WB_ALLOC_ERROR_HANDLER("failed to grow pool occupancy bitmap",
+				pool, pool->name);
+		return 0;
+	}
+	pool->occupiedWords = words;
+	return 1;
+}
+
+/* Grows the pool by at least slots, or returns 0 with the capacity it
+ * already had. The push is sized from the end of the slots, not from the
+ * arena's head: an arena that kept pages committed past its head would
+ * otherwise serve the push without committing anything new. */
+static
+isize wbi__poolGrow(MemoryPool* pool, isize slots)
+{
+	void* ret;
+	isize old, want;
+	char *need, *head;
+	if(pool->flags & FlagPoolFixedSize) {
+		WB_ALLOC_ERROR_HANDLER("pool ran out of memory",
+				pool, pool->name);
+		return 0;
+	}
+
+	old = pool->capacity;
+	want = old + slots;
+	need = (char*)pool->slots + want * pool->elementSize;
+	head = (char*)pool->alloc->head;
+	if(need > head) {
+		ret = arenaPush(pool->alloc, alignTo((usize)(need - head), 
+					pool->alloc->info.commitSize));
+		if(!ret) {
+			WB_ALLOC_ERROR_HANDLER("arenaPush failed in poolRetrieve", 
+					pool, pool->name);
+			return 0;
+		}
+	}
+	pool->capacity = (isize)
+		((char*)pool->alloc->end - (char*)pool->slots) / pool->elementSize;
+	if(!wbi__poolReserveOccupancy(pool)) {
+		pool->capacity = old;
+		return 0;
+	}
+#ifdef WB_ALLOC_STATS
+	pool->stats.commits++;
+	wbi__statsSetCommitted(&pool->stats, 
+			pool->capacity * pool->elementSize);
+#endif
+	if(pool->capacity < want) {
+		WB_ALLOC_ERROR_HANDLER("pool failed to grow", pool, pool->name);
+		return 0;
+	}
+	return 1;
+}
+
 WB_ALLOC_API
 void poolInit(MemoryPool* pool, MemoryArena* alloc, 
 		usize elementSize,
 		isize flags)
 {
+	usize available;
+	MemoryInfo info;
 #ifndef WB_ALLOC_NO_ZERO_ON_INIT
 	WB_ALLOC_MEMSET(pool, 0, sizeof(MemoryPool));
 #endif
@@ -1076,11 +1818,50 @@ void poolInit(MemoryPool* pool, MemoryArena* alloc,
 		elementSize;
 	pool->count = 0;
 	pool->lastFilled = -1;
-	pool->capacity = (isize)
-		((char*)alloc->end - (char*)alloc->head) / elementSize;
-
-	pool->slots = alloc->head;
 	pool->freeList = NULL;
+
+	available = (usize)((char*)alloc->end - (char*)alloc->head);
+	if(alloc->flags & FlagArenaFixedSize) {
+		isize words;
+		pool->capacity = (isize)(available * 8 / (pool->elementSize * 8 + 1));
+		words = (pool->capacity + wbi__WordBits - 1) / wbi__WordBits;
+		while(words * sizeof(usize) + 
+				pool->capacity * pool->elementSize > available) {
+			pool->capacity--;
+			words = (pool->capacity + wbi__WordBits - 1) / wbi__WordBits;
+		}
+
+		pool->occupied = (usize*)alloc->head;
+		pool->occupiedWords = words;
+		pool->occupiedAlloc = NULL;
+		WB_ALLOC_MEMSET(pool->occupied, 0, words * sizeof(usize));
+		pool->slots = pool->occupied + words;
+	} else {
+		info = alloc->info;
+		info.totalMemory = alignTo(sizeof(MemoryArena) + 16 + 
+				(info.totalMemory / pool->elementSize / wbi__WordBits + 1) *
+				sizeof(usize), 
+				info.pageSize);
+		info.commitSize = info.pageSize;
+		pool->occupiedAlloc = arenaBootstrap(info, FlagArenaNormal);
+		if(!pool->occupiedAlloc) {
+			WB_ALLOC_ERROR_HANDLER("failed to create pool occupancy bitmap",
+					pool, pool->name);
+			return;
+		}
+		pool->occupiedAlloc->name = "pool.occupancy";
+		pool->occupied = (usize*)pool->occupiedAlloc->head;
+		pool->occupiedWords = 0;
+
+		pool->slots = alloc->head;
+		pool->capacity = (isize)(available / pool->elementSize);
+		wbi__poolReserveOccupancy(pool);
+	}
+
+#ifdef WB_ALLOC_STATS
+	wbi__statsSetCommitted(&pool->stats, pool->capacity * pool->elementSize);
+	wbi__statsRegister(wbi__StatsPool, pool);
+#endif
 }
 
 WB_ALLOC_API
@@ -1135,39 +1916,31 @@ void* poolFromIndex(MemoryPool* pool, isize index)
 WB_ALLOC_API
 void* poolRetrieve(MemoryPool* pool)
 {
-	void *ptr, *ret;
+	void* ptr;
+	isize index;
 	ptr = NULL;
 	if((!(pool->flags & FlagPoolCompacting)) && pool->freeList) {
 		ptr = pool->freeList;
 		pool->freeList = (void**)*pool->freeList;
-		pool->count++;
-
-		if(!(pool->flags & FlagPoolNoZeroMemory)) {
-			WB_ALLOC_MEMSET(ptr, 0, pool->elementSize);
-		}
-
-		return ptr;
-	} 
-
-	if(pool->lastFilled >= pool->capacity - 1) {
-		if(pool->flags & FlagPoolFixedSize) {
-			WB_ALLOC_ERROR_HANDLER("pool ran out of memory",
-					pool, pool->name);
-			return NULL;
+		index = ((char*)ptr - (char*)pool->slots) / (isize)pool->elementSize;
+	} else {
+		if(pool->lastFilled >= pool->capacity - 1) {
+			if(!wbi__poolGrow(pool, 1)) {
+				return NULL;
+			}
 		}
 
-		ret = arenaPush(pool->alloc, pool->alloc->info.commitSize);
-		if(!ret) {
-			WB_ALLOC_ERROR_HANDLER("arenaPush failed in poolRetrieve", 
-					pool, pool->name);
-			return NULL;
-		}
-		pool->capacity = (isize)
-			((char*)pool->alloc->end - (char*)pool->slots) / pool->elementSize;
+		index = ++pool->lastFilled;
+		ptr = (char*)pool->slots + index * pool->elementSize;
 	}
 
-	ptr = (char*)pool->slots + ++pool->lastFilled * pool->elementSize;
+	pool->occupied[index / wbi__WordBits] |= 
+		(usize)1 << (index % wbi__WordBits);
 	pool->count++;
+#ifdef WB_ALLOC_STATS
+	pool->stats.allocations++;
+	wbi__statsSetUsed(&pool->stats, pool->count * pool->elementSize);
+#endif
 	if(!(pool->flags & FlagPoolNoZeroMemory)) {
 		WB_ALLOC_MEMSET(ptr, 0, pool->elementSize);
 	}
@@ -1177,31 +1950,145 @@ void* poolRetrieve(MemoryPool* pool)
 WB_ALLOC_API
 void poolRelease(MemoryPool* pool, void* ptr)
 {
-	pool->count--;
+	isize index;
+	usize *word, bit;
+	void* last;
+
+	index = ((char*)ptr - (char*)pool->slots) / (isize)pool->elementSize;
+	word = pool->occupied + index / wbi__WordBits;
+	bit = (usize)1 << (index % wbi__WordBits);
+
+	if(!(pool->flags & FlagPoolNoDoubleFreeCheck)) {
+		if((char*)ptr < (char*)pool->slots || index > pool->lastFilled ||
+				(char*)ptr != (char*)pool->slots + index * pool->elementSize) {
+			WB_ALLOC_ERROR_HANDLER("pointer passed to poolRelease is not "
+					"a slot in this pool", 
+					pool, pool->name);
+			return;
+		}
 
-	if(pool->freeList && !(pool->flags & FlagPoolNoDoubleFreeCheck)) {
-		void** localList = pool->freeList;
-		do {
-			if(ptr == localList) {
-				WB_ALLOC_ERROR_HANDLER("caught attempting to free previously "
-						"freed memory in poolRelease", 
-						pool, pool->name);
-				return;
-			}
-		} while((localList = (void**)*localList));
+		if(!(*word & bit)) {
+			WB_ALLOC_ERROR_HANDLER("caught attempting to free previously "
+					"freed memory in poolRelease", 
+					pool, pool->name);
+			return;
+		}
 	}
 
+	pool->count--;
+#ifdef WB_ALLOC_STATS
+	pool->stats.frees++;
+	wbi__statsSetUsed(&pool->stats, pool->count * pool->elementSize);
+#endif
+
 	if(pool->flags & FlagPoolCompacting) {
-		WB_ALLOC_MEMCPY(ptr, 
-				(char*)pool->slots + pool->count * pool->elementSize,
-				pool->elementSize);
+		/* NOTE: compacting pools never have holes, so the slot
+		 * that goes away is always the last one */
+		last = (char*)pool->slots + pool->lastFilled * pool->elementSize;
+		if(last != ptr) {
+			WB_ALLOC_MEMCPY(ptr, last, pool->elementSize);
+		}
+		pool->occupied[pool->lastFilled / wbi__WordBits] &= 
+			~((usize)1 << (pool->lastFilled % wbi__WordBits));
+		pool->lastFilled--;
 		return;
 	}
 
+	*word &= ~bit;
 	*(void**)ptr = pool->freeList;
 	pool->freeList = (void**)ptr;
 }
 
+WB_ALLOC_API
+isize poolRetrieveN(MemoryPool* pool, void** out, isize count)
+{
+	isize i, j, index, run;
+	char* ptr;
+
+	i = 0;
+	if(!(pool->flags & FlagPoolCompacting)) {
+		while(i < count && pool->freeList) {
+			ptr = (char*)pool->freeList;
+			pool->freeList = (void**)*pool->freeList;
+			index = (ptr - (char*)pool->slots) / (isize)pool->elementSize;
+			pool->occupied[index / wbi__WordBits] |= 
+				(usize)1 << (index % wbi__WordBits);
+			if(!(pool->flags & FlagPoolNoZeroMemory)) {
+				WB_ALLOC_MEMSET(ptr, 0, pool->elementSize);
+			}
+			out[i++] = ptr;
+		}
+	}
+
+	/* Whatever the free list couldn't cover comes out of the end of the 
+	 * pool in one contiguous run, so it only needs one capacity check,
+	 * one memset, and a few whole-word bitmap writes. */
+	run = count - i;
+	if(run > 0) {
+		if(pool->lastFilled + run >= pool->capacity) {
+			/* On failure the capacity may still have grown some, and
+			 * the bitmap covers whatever it is now */
+			if(!wbi__poolGrow(pool, pool->lastFilled + run + 1 - 
+						pool->capacity)) {
+				run = pool->capacity - 1 - pool->lastFilled;
+			}
+		}
+
+		index = pool->lastFilled + 1;
+		ptr = (char*)pool->slots + index * pool->elementSize;
+		if(run > 0) {
+			if(!(pool->flags & FlagPoolNoZeroMemory)) {
+				WB_ALLOC_MEMSET(ptr, 0, run * pool->elementSize);
+			}
+			wbi__poolSetBits(pool, index, run);
+			for(j = 0; j < run; ++j) {
+				out[i++] = ptr + j * pool->elementSize;
+			}
+			pool->lastFilled += run;
+		}
+	}
+
+	pool->count += i;
+#ifdef WB_ALLOC_STATS
+	pool->stats.allocations += i;
+	wbi__statsSetUsed(&pool->stats, pool->count * pool->elementSize);
+#endif
+	return i;
+}
+
+WB_ALLOC_API
+void poolReleaseN(MemoryPool* pool, void** ptrs, isize count)
+{
+	isize i;
+	for(i = 0; i < count; ++i) {
+		poolRelease(pool, ptrs[i]);
+	}
+}
+
+WB_ALLOC_API
+void* poolIterNext(MemoryPool* pool, isize* index)
+{
+	isize i, word, lastWord;
+	usize bits;
+
+	i = *index < 0 ? 0 : *index;
+	if(i > pool->lastFilled) return NULL;
+
+	word = i / wbi__WordBits;
+	lastWord = pool->lastFilled / wbi__WordBits;
+	bits = pool->occupied[word] & (~(usize)0 << (i % wbi__WordBits));
+	for(;;) {
+		if(bits) {
+			i = word * wbi__WordBits + wbi__countTrailingZeros(bits);
+			if(i > pool->lastFilled) return NULL;
+			*index = i + 1;
+			return (char*)pool->slots + i * pool->elementSize;
+		}
+		if(++word > lastWord) return NULL;
+		bits = pool->occupied[word];
+	}
+}
+
 /*
  * TODO(will): Maybe, someday, have a tagged heap that uses real memoryArenas
  * 	behind the scenes, so that you get to benefit from stack and extended 
@@ -1227,12 +2114,23 @@ void taggedInit(TaggedHeap* heap, MemoryArena* arena,
 	heap->flags = flags;
 	heap->align = 8;
 	heap->arenaSize = internalArenaSize;
+	heap->info = arena->info;
+
+	/* NOTE: when we own the pages, arenas come out of the pool 
+	 * either freshly committed or zeroed by taggedFree, so the pool doesn't
+	 * have to memset the whole thing again. A fixed-size buffer could have 
+	 * anything in it the first time around. */
 	poolInit(&heap->pool, arena, 
 			internalArenaSize + sizeof(wbi__TaggedHeapArena), 
 			FlagPoolNormal | FlagPoolNoDoubleFreeCheck | 
-			((flags & FlagTaggedHeapNoZeroMemory) ? 
+			(((flags & FlagTaggedHeapNoZeroMemory) || 
+			 !(arena->flags & FlagArenaFixedSize)) ? 
 			FlagPoolNoZeroMemory : 
 			0));
+#ifdef WB_ALLOC_STATS
+	heap->pool.name = "taggedHeap.pool";
+	wbi__statsRegister(wbi__StatsTaggedHeap, heap);
+#endif
 }
 
 WB_ALLOC_API
@@ -1251,6 +2149,10 @@ TaggedHeap* taggedBootstrap(MemoryInfo info,
 	strapped = (TaggedHeap*)arenaPush(arena, sizeof(TaggedHeap) + 16);
 	taggedInit(&heap, arena, arenaSize, flags);
 	*strapped = heap;
+#ifdef WB_ALLOC_STATS
+	wbi__statsMove(&heap, strapped);
+	wbi__statsMove(&heap.pool, &strapped->pool);
+#endif
 	return strapped;
 }
 
@@ -1368,13 +2270,21 @@ void* taggedAlloc(TaggedHeap* heap, isize tag, usize size)
 				return NULL;
 			}
 			wbi__taggedArenaInit(heap, newArena, tag);
-			newArena->next = arena;
+			newArena->next = heap->arenas[tag];
+			heap->arenas[tag] = newArena;
 			arena = newArena;
 		}
 	}
 
 	oldHead = arena->head;
 	arena->head = (void*)alignTo((isize)arena->head + size, heap->align);
+#ifdef WB_ALLOC_STATS
+	heap->stats.allocations++;
+	heap->stats.alignmentWaste += (isize)arena->head - (isize)oldHead - size;
+	wbi__statsSetUsed(&heap->stats, heap->stats.used + 
+			(isize)arena->head - (isize)oldHead);
+	wbi__statsSetCommitted(&heap->stats, heap->pool.count * heap->arenaSize);
+#endif
 	return oldHead;
 }
 
@@ -1382,11 +2292,313 @@ WB_ALLOC_API
 void taggedFree(TaggedHeap* heap, isize tag)
 {
 	wbi__TaggedHeapArena *head;
+	usize used;
 	if((head = heap->arenas[tag])) do {
+		used = (usize)head->head - (usize)&head->buffer;
+#ifdef WB_ALLOC_STATS
+		heap->stats.used -= used;
+#endif
+		/* Only the part of the arena that was used can be dirty */
+		if(!(heap->flags & FlagTaggedHeapNoZeroMemory)) {
+			wbi__zeroMemory(&heap->info, &head->buffer, used,
+					!(heap->pool.alloc->flags & FlagArenaFixedSize));
+		}
 		poolRelease(&heap->pool, head);
 	} while((head = head->next));
 	heap->arenas[tag] = NULL;
+#ifdef WB_ALLOC_STATS
+	heap->stats.frees++;
+	wbi__statsSetCommitted(&heap->stats, heap->pool.count * heap->arenaSize);
+#endif
 }
+
+#ifdef WB_ALLOC_STATS
+/* Instrumentation */
+typedef struct wbi__StatsObject wbi__StatsObject;
+struct wbi__StatsObject
+{
+	isize kind;
+	void* object;
+};
+
+static wbi__StatsObject wbi__statsObjects[WB_ALLOC_STATS_MAX_OBJECTS];
+static isize wbi__statsObjectCount;
+static isize wbi__statsLock;
+static MemoryCallsite wbi__callsites[WB_ALLOC_STATS_MAX_CALLSITES];
+
+WB_ALLOC_API
+void wbi__statsRegister(isize kind, void* object)
+{
+	isize i;
+	wbi__spinLock(&wbi__statsLock);
+	for(i = 0; i < wbi__statsObjectCount; ++i) {
+		if(!wbi__statsObjects[i].object || 
+				wbi__statsObjects[i].object == object) {
+			break;
+		}
+	}
+
+	if(i < WB_ALLOC_STATS_MAX_OBJECTS) {
+		wbi__statsObjects[i].kind = kind;
+		wbi__statsObjects[i].object = object;
+		if(i == wbi__statsObjectCount) {
+			wbi__statsObjectCount++;
+		}
+	}
+	wbi__spinUnlock(&wbi__statsLock);
+}
+
+WB_ALLOC_API
+void wbi__statsMove(void* from, void* to)
+{
+	isize i;
+	wbi__spinLock(&wbi__statsLock);
+	for(i = 0; i < wbi__statsObjectCount; ++i) {
+		if(wbi__statsObjects[i].object == from) {
+			wbi__statsObjects[i].object = to;
+			break;
+		}
+	}
+	wbi__spinUnlock(&wbi__statsLock);
+}
+
+WB_ALLOC_API
+void wbi__statsUnregister(void* object)
+{
+	isize i;
+	wbi__spinLock(&wbi__statsLock);
+	for(i = 0; i < wbi__statsObjectCount; ++i) {
+		if(wbi__statsObjects[i].object == object) {
+			wbi__statsObjects[i].object = NULL;
+			wbi__statsObjects[i].kind = 0;
+			break;
+		}
+	}
+	wbi__spinUnlock(&wbi__statsLock);
+}
+
+WB_ALLOC_API
+void wbi__statsSetUsed(MemoryStats* stats, usize used)
+{
+	usize peak;
+	stats->used = used;
+	while(used > (peak = *(usize volatile*)&stats->peakUsed)) {
+		if(wbi__CompareAndSwap(&stats->peakUsed, peak, used)) break;
+	}
+}
+
+WB_ALLOC_API
+void wbi__statsSetCommitted(MemoryStats* stats, usize committed)
+{
+	usize peak;
+	stats->committed = committed;
+	while(committed > (peak = *(usize volatile*)&stats->peakCommitted)) {
+		if(wbi__CompareAndSwap(&stats->peakCommitted, peak, committed)) break;
+	}
+}
+
+WB_ALLOC_API
+void wbi__statsCallsite(const char* file, isize line, usize size)
+{
+	usize key, mask, i, bucket;
+	MemoryCallsite* site;
+
+	/* NOTE: __FILE__ strings are pooled by the compiler, so the 
+	 * pointer is good enough to key on. Slots are claimed with a CAS on 
+	 * key, and everything else is an atomic add, so this is safe to call 
+	 * from any thread. If the table fills up, new call sites are dropped.
+	 */
+	key = (((usize)file * 31) ^ ((usize)line * 2654435761u)) | 1;
+	mask = WB_ALLOC_STATS_MAX_CALLSITES - 1;
+	for(i = 0; i <= mask; ++i) {
+		site = wbi__callsites + ((key + i) & mask);
+		if(site->key == key) break;
+		if(!site->key && wbi__CompareAndSwap(&site->key, 0, key)) {
+			site->file = file;
+			site->line = line;
+			break;
+		}
+		if(site->key == key) break;
+	}
+	if(i > mask) return;
+
+	wbi__AtomicAdd(&site->count, 1);
+	wbi__AtomicAdd(&site->bytes, size);
+
+	bucket = 0;
+	size >>= 4;
+	while(size && bucket < WB_ALLOC_STATS_HISTOGRAM_BUCKETS - 1) {
+		size >>= 1;
+		bucket++;
+	}
+
+	wbi__AtomicAdd(&site->histogram[bucket], 1);
+}
+
+WB_ALLOC_API
+void* arenaPushAt(MemoryArena* arena, isize size, 
+		const char* file, isize line)
+{
+	void* ret = arenaPushEx(arena, size, 0);
+	if(ret) {
+		wbi__statsCallsite(file, line, size);
+	}
+	return ret;
+}
+
+WB_ALLOC_API
+void* poolRetrieveAt(MemoryPool* pool, const char* file, isize line)
+{
+	void* ret = poolRetrieve(pool);
+	if(ret) {
+		wbi__statsCallsite(file, line, pool->elementSize);
+	}
+	return ret;
+}
+
+WB_ALLOC_API
+void* taggedAllocAt(TaggedHeap* heap, isize tag, usize size, 
+		const char* file, isize line)
+{
+	void* ret = taggedAlloc(heap, tag, size);
+	if(ret) {
+		wbi__statsCallsite(file, line, size);
+	}
+	return ret;
+}
+
+static
+MemoryStats* wbi__statsOf(wbi__StatsObject* o, const char** name)
+{
+	switch(o->kind) {
+		case wbi__StatsArena:
+			*name = ((MemoryArena*)o->object)->name;
+			return &((MemoryArena*)o->object)->stats;
+		case wbi__StatsPool:
+			*name = ((MemoryPool*)o->object)->name;
+			return &((MemoryPool*)o->object)->stats;
+		case wbi__StatsTaggedHeap:
+			*name = ((TaggedHeap*)o->object)->name;
+			return &((TaggedHeap*)o->object)->stats;
+	}
+	return NULL;
+}
+
+WB_ALLOC_API
+isize memoryStatsQuery(const char* name, MemoryStats* out)
+{
+	isize i, found = 0;
+	const char *a, *b;
+	MemoryStats* stats;
+	WB_ALLOC_MEMSET(out, 0, sizeof(MemoryStats));
+
+	wbi__spinLock(&wbi__statsLock);
+	for(i = 0; i < wbi__statsObjectCount; ++i) {
+		stats = wbi__statsOf(wbi__statsObjects + i, &a);
+		if(!stats) continue;
+		b = name;
+		if(a) while(*a && *a == *b) { a++; b++; }
+		if(!a || *a != *b) continue;
+
+		out->used += stats->used;
+		out->peakUsed += stats->peakUsed;
+		out->committed += stats->committed;
+		out->peakCommitted += stats->peakCommitted;
+		out->alignmentWaste += stats->alignmentWaste;
+		out->allocations += stats->allocations;
+		out->frees += stats->frees;
+		out->commits += stats->commits;
+		found++;
+	}
+	wbi__spinUnlock(&wbi__statsLock);
+	return found;
+}
+
+static
+void wbi__statsJsonString(FILE* fp, const char* s)
+{
+	fputc('"', fp);
+	if(s) for(; *s; ++s) {
+		if(*s == '"' || *s == '\\') fputc('\\', fp);
+		fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+WB_ALLOC_API
+isize memoryStatsDumpJson(const char* filename)
+{
+	isize i, j, first;
+	const char* name;
+	static const char* kinds[] = {"", "arena", "pool", "taggedHeap"};
+	MemoryStats* stats;
+	MemoryCallsite* site;
+	FILE* fp = fopen(filename, "w");
+	if(!fp) return 0;
+
+	fprintf(fp, "{\n\t\"objects\": [");
+	first = 1;
+	wbi__spinLock(&wbi__statsLock);
+	for(i = 0; i < wbi__statsObjectCount; ++i) {
+		stats = wbi__statsOf(wbi__statsObjects + i, &name);
+		if(!stats) continue;
+		fprintf(fp, "%s\n\t\t{\"name\": ", first ? "" : ",");
+		wbi__statsJsonString(fp, name);
+		fprintf(fp, ", \"kind\": \"%s\", "
+				"\"used\": %llu, \"peakUsed\": %llu, "
+				"\"committed\": %llu, \"peakCommitted\": %llu, "
+				"\"alignmentWaste\": %llu, \"allocations\": %llu, "
+				"\"frees\": %llu, \"commits\": %llu}",
+				kinds[wbi__statsObjects[i].kind],
+				(unsigned long long)stats->used,
+				(unsigned long long)stats->peakUsed,
+				(unsigned long long)stats->committed,
+				(unsigned long long)stats->peakCommitted,
+				(unsigned long long)stats->alignmentWaste,
+				(unsigned long long)stats->allocations,
+				(unsigned long long)stats->frees,
+				(unsigned long long)stats->commits);
+		first = 0;
+	}
+	wbi__spinUnlock(&wbi__statsLock);
+
+	fprintf(fp, "\n\t],\n\t\"callsites\": [");
+	first = 1;
+	for(i = 0; i < WB_ALLOC_STATS_MAX_CALLSITES; ++i) {
+		site = wbi__callsites + i;
+		if(!site->key || !site->file) continue;
+		fprintf(fp, "%s\n\t\t{\"file\": ", first ? "" : ",");
+		wbi__statsJsonString(fp, site->file);
+		fprintf(fp, ", \"line\": %lld, \"count\": %llu, \"bytes\": %llu, "
+				"\"histogram\": [",
+				(long long)site->line,
+				(unsigned long long)site->count,
+				(unsigned long long)site->bytes);
+		for(j = 0; j < WB_ALLOC_STATS_HISTOGRAM_BUCKETS; ++j) {
+			fprintf(fp, j ? ", %llu" : "%llu", 
+					(unsigned long long)site->histogram[j]);
+		}
+		fprintf(fp, "]}");
+		first = 0;
+	}
+	fprintf(fp, "\n\t]\n}\n");
+	fclose(fp);
+	return 1;
+}
+#endif
+#endif
+
+/* NOTE: these come after the implementation so the definitions above
+ * don't get rewritten, but everything that includes this header afterwards
+ * gets its allocations attributed to the line they came from.
+ */
+#if defined(WB_ALLOC_STATS) && !defined(WB_ALLOC_NO_CALLSITE_MACROS)
+#define arenaPush(arena, size) \
+	arenaPushAt((arena), (size), __FILE__, __LINE__)
+#define poolRetrieve(pool) \
+	poolRetrieveAt((pool), __FILE__, __LINE__)
+#define taggedAlloc(heap, tag, size) \
+	taggedAllocAt((heap), (tag), (size), __FILE__, __LINE__)
 #endif
 
 #ifndef WB_ALLOC_NO_DISABLE_STUPID_MSVC_WARNINGS
@@ -2989,8 +2989,10 @@ static void wbgl__load_proc_error(const char* name, struct wbgl_ErrorContext* ct
 
 
 #ifdef WBGL_SDL
+#ifdef _WIN32
 #include <Windows.h>
 #include <Wingdi.h>
+#endif
 static void* wbgl__load_proc(const char* name, struct wbgl_ErrorContext* ctx, void* userdata)
 {
 	void* p = (void*)SDL_GL_GetProcAddress(name);
@@ -40,7 +40,11 @@
 #pragma once
 
 #ifndef WBTM_NO_INCLUDE 
+#ifdef _MSC_VER
 #include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 #include <emmintrin.h>
 #include <xmmintrin.h>
 #endif
@@ -2,7 +2,12 @@
 #include <stdint.h>
 #include <stdlib.h> 
 #include <stdio.h> 
+#include <stdarg.h>
+#ifdef _MSC_VER
 #include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
 #define SDL_MAIN_HANDLED
 #include <SDL2/SDL.h>
@@ -46,19 +51,93 @@
 #include "wplInternal.h"
 
 #include "wplShaders.h"
+#include "wplThreads.c"
+#include "wplProfile.c"
 #include "wplRender.c"
+#include "wplSoftware.c"
+#include "wplLoader.c"
+#include "wplFormat.c"
+#ifdef WPL_FONT
+#include "wplKerning.c"
+#endif
 
+/* Only SDL's core comes up here; subsystems are started as they're 
+ * needed, so we never pay for joysticks, haptics or controllers */
 i64 wplInit()
 {
 	SDL_SetMainReady();
-	int ret = SDL_Init(SDL_INIT_EVERYTHING);
+	int ret = SDL_Init(0);
+	wplStartupMark("SDL");
 	return ret;
 }
 
+static
+i32 initSubsystem(u32 flags)
+{
+	if(SDL_WasInit(flags) == flags) return 0;
+	return SDL_InitSubSystem(flags);
+}
+
+wplWindow* wplFrameWindow;
+
+static
+void initFrameArenas(wplWindow* window)
+{
+	for(isize i = 0; i < 2; ++i) {
+		MemoryArena* frame = arenaBootstrap(getMemoryInfo(), 
+				FlagArenaNoZeroMemory);
+		frame->name = "frame";
+		window->frameArenas[i] = frame;
+		window->frameStarts[i] = arenaCheckpoint(frame);
+	}
+	window->frameIndex = 0;
+	wplFrameWindow = window;
+}
+
+static
+i64 createHeadlessWindow(wplWindowDef* def, wplWindow* window)
+{
+	wplHeadless = 1;
+	window->glVersion = 0;
+	window->windowHandle = NULL;
+	window->refreshRate = 0;
+	window->lastTicks = 0;
+	window->elapsedTicks = 0;
+
+	MemoryArena* softArena = arenaBootstrap(getMemoryInfo(), 
+			FlagArenaNoZeroMemory);
+	softArena->name = "soft";
+	window->soft = wplSoftCreateTarget(def->width, def->height, softArena);
+
+	window->basePath = SDL_GetBasePath();
+	initFrameArenas(window);
+	return 1;
+}
+
 i64 wplCreateWindow(wplWindowDef* def, wplWindow* window)
 {
 	i64 wposx, wposy;
 
+	if(def->width == 0) {
+		def->width = 1280;
+	} 
+
+	if(def->height == 0) {
+		def->height = 720;
+	}
+
+	window->soft = NULL;
+	if(def->headless) {
+		initSubsystem(SDL_INIT_TIMER);
+		return createHeadlessWindow(def, window);
+	}
+
+	if(initSubsystem(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
+		fprintf(stderr, "Error: could not start SDL video: %s\n", SDL_GetError());
+		return 0;
+	}
+	wplStartupMark("SDL video");
+
 #define GLattr(attr, val) SDL_GL_SetAttribute(SDL_GL_##attr, val)
 	GLattr(RED_SIZE, 8);
 	GLattr(GREEN_SIZE, 8);
@@ -83,14 +162,6 @@ i64 wplCreateWindow(wplWindowDef* def, wplWindow* window)
 		wposy = def->y;
 	}
 
-	if(def->width == 0) {
-		def->width = 1280;
-	} 
-
-	if(def->height == 0) {
-		def->height = 720;
-	}
-
 	SDL_Window* windowHandle = SDL_CreateWindow(
 			def->title,
 			wposx, wposy,
@@ -102,6 +173,7 @@ i64 wplCreateWindow(wplWindowDef* def, wplWindow* window)
 
 	printf("%s\n", SDL_GetError());
 	window->windowHandle = windowHandle;
+	wplStartupMark("window");
 
 	SDL_DisplayMode dm = {0};
 	SDL_GetWindowDisplayMode(windowHandle, &dm);
@@ -132,10 +204,12 @@ i64 wplCreateWindow(wplWindowDef* def, wplWindow* window)
 	}
 
 	SDL_GL_MakeCurrent(windowHandle, glContext);
+	wplStartupMark("GL context");
 	{
 		struct wbgl_ErrorContext ctx;
 		wbgl_load(&ctx);
 	}
+	wplStartupMark("GL loaded");
 
 	switch(window->glVersion) {
 		case 21:
@@ -157,15 +231,92 @@ i64 wplCreateWindow(wplWindowDef* def, wplWindow* window)
 	window->basePath = SDL_GetBasePath();
 	SDL_GL_SetSwapInterval(1);
 
+	initFrameArenas(window);
+
 	return windowHandle == NULL ? 0 : 1;
 }
 
 void wplShowWindow(wplWindow* wpl)
 {
+	if(!wpl->windowHandle) return;
 	SDL_ShowWindow(wpl->windowHandle);
 }
 
 wplInputState* wplInput;
+
+void* wplFrameAlloc(isize size)
+{
+	return arenaPush(wplFrameWindow->frameArenas[wplFrameWindow->frameIndex], 
+			size);
+}
+
+static
+char* frameFormatV(wplFormat* f, va_list args)
+{
+	MemoryArena* frame;
+	va_list again;
+	isize available, len;
+	char* ret;
+
+	frame = wplFrameWindow->frameArenas[wplFrameWindow->frameIndex];
+
+	// Format straight into the free space at the head; we only need to
+	// format twice when the string doesn't fit in what's committed
+	va_copy(again, args);
+	ret = frame->head;
+	available = (isize)frame->end - (isize)frame->head;
+	if(f->fallback) {
+		len = vsnprintf(ret, available, f->fmt, args);
+	} else {
+		len = formatWrite(f, ret, available, args);
+	}
+	if(len < 0) len = 0;
+
+	if(len < available) {
+		va_end(again);
+		return arenaPush(frame, len + 1);
+	}
+
+	ret = arenaPush(frame, len + 1);
+	if(f->fallback) {
+		vsnprintf(ret, len + 1, f->fmt, again);
+	} else {
+		formatWrite(f, ret, len + 1, again);
+	}
+	va_end(again);
+	return ret;
+}
+
+/* The format is split up on every call here; hot call sites should keep
+ * a static wplFormat and use wplFrameFormat */
+char* wplFramePrintf(const char* fmt, ...)
+{
+	wplFormat f;
+	va_list args;
+	char* ret;
+
+	f.fmt = fmt;
+	wplFormatCompile(&f);
+	va_start(args, fmt);
+	ret = frameFormatV(&f, args);
+	va_end(args);
+	return ret;
+}
+
+char* wplFrameFormat(wplFormat* f, ...)
+{
+	va_list args;
+	char* ret;
+
+	if(!f->compiled) {
+		wplFormatCompile(f);
+	}
+	va_start(args, f);
+	ret = frameFormatV(f, args);
+	va_end(args);
+	return ret;
+}
+
 void wplInputUpdate()
 {
 	i8* keys;
@@ -203,9 +354,27 @@ void wplInputUpdate()
 i64 wplUpdate(wplWindow* window, wplState* state)
 {
 	window->lastTicks = SDL_GetTicks();
+	profileFrameStart();
+	loaderPump(window);
 	wplState lstate;
 	SDL_Event event;
 
+	wplFrameWindow = window;
+	window->frameIndex ^= 1;
+	arenaRewind(window->frameStarts[window->frameIndex]);
+
+	// Headless windows have no events; input just ages a frame
+	if(window->soft) {
+		state->width = window->soft->w;
+		state->height = window->soft->h;
+		state->hasFocus = 1;
+		wplInput = state->input;
+		wplInputUpdate();
+		wplSoftClear(window->soft);
+		profileUpdateEnd();
+		return 1;
+	}
+
 	{
 		int width, height;
 		SDL_GetWindowSize(window->windowHandle, &width, &height);
@@ -279,12 +448,22 @@ i64 wplUpdate(wplWindow* window, wplState* state)
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
 	*state = lstate;
+	profileUpdateEnd();
 	return 1;
 }
 
 i64 wplRender(wplWindow* window)
 {
+	profileRenderStart();
+	// Nothing to present or wait on; frames go as fast as they draw
+	if(window->soft) {
+		window->elapsedTicks = SDL_GetTicks() - window->lastTicks;
+		profileRenderEnd();
+		return 0;
+	}
 	SDL_GL_SwapWindow(window->windowHandle);
+	// The delay below is idle time, not render time
+	profileRenderEnd();
 	window->elapsedTicks = SDL_GetTicks() - window->lastTicks;
 	if(window->elapsedTicks < 16) {
 		SDL_Delay(16 - window->elapsedTicks);
@@ -292,6 +471,11 @@ i64 wplRender(wplWindow* window)
 	return 0;
 }
 
+void wplSleep(i32 ms)
+{
+	SDL_Delay(ms);
+}
+
 i64 wplKeyIsDown(i64 keycode)
 {
 	return wplInput->keyboard[keycode] >= Button_Down;
@@ -356,12 +540,12 @@ void wplCopyMemoryBlock(void* dest, const void* source,
 		for(isize i = 0; i < sh; ++i) {
 			wplCopyMemory(
 					dst + ((i+dy) * dw + (dx-1)) * size, 
-					dst + ((i+sy) * dw + sx) * size,
+					dst + ((i+dy) * dw + dx) * size,
 					1 * size);
 
 			wplCopyMemory(
 					dst + ((i+dy) * dw + (dx+sw)) * size, 
-					src + ((i+sy) * dw + (sx+sw-1)) * size,
+					dst + ((i+dy) * dw + (dx+sw-1)) * size,
 					1 * size);
 		}
 
@@ -463,7 +647,15 @@ void* wplCopyMemory(void *dest, const void *source, i64 size)
 			wbssecpy_mv(224, 240, 256);
 		}
 	} else if(size <= (1 << 21)) {
+#ifdef _MSC_VER
 		__movsb(dst, src, size);
+#else
+		u8* d = dst;
+		const u8* s = src;
+		usize n = size;
+		__asm__ __volatile__("rep movsb" 
+				: "+D"(d), "+S"(s), "+c"(n) : : "memory");
+#endif
 	} else {
 		i32 dstalign = (((usize)dst + 15) & -16) == (usize)dst;
 		i32 srcalign = (((usize)src + 15) & -16) == (usize)src;
@@ -561,15 +753,6 @@ u8* wplReadEntireFile(char* filename, isize* size_out, MemoryArena* arena)
 }
 
 #ifdef WPL_FONT
-void wplPopulateKerning(void* info, wplKerning* k, isize start, isize end)
-{
-	for(isize i = start; i < end; ++i) {
-		for(isize j = start; j < end; ++j) {
-			k->kern[i][j] = stbtt_GetCodepointKernAdvance(info, i, j);
-		}
-	}
-}
-
 i32 wplGetGlyphIndexFromCodepoint(void* info, i32 codepoint) 
 {
 	return stbtt_FindGlyphIndex(info, codepoint);
@@ -660,6 +843,148 @@ f32 wplGetFontScale(void* font, i64 pixels)
 {
 	return stbtt_ScaleForPixelHeight(font, pixels);
 }
+
+/* Renders codepoints [first, first + count) once, as distance fields, 
+ * into a single atlas. Every size draws from it with Sprite_Sdf, so 
+ * changing the UI scale never re-rasterizes anything; pixelHeight only 
+ * sets how much detail the atlas keeps. Glyphs that don't fit in 4096^2 
+ * are left empty. The atlas is not uploaded. */
+wplSdfFont* wplCreateSdfFont(void* fontInfo, f32 pixelHeight,
+		i32 first, i32 count, MemoryArena* arena)
+{
+	stbtt_fontinfo* info = fontInfo;
+	f32 scale = stbtt_ScaleForPixelHeight(info, pixelHeight);
+
+	wplSdfFont* font = arenaPush(arena, sizeof(wplSdfFont));
+	memset(font, 0, sizeof(wplSdfFont));
+	font->size = pixelHeight;
+	font->first = first;
+	font->count = count;
+	font->glyphs = arenaPush(arena, sizeof(wplSdfGlyph) * count);
+	memset(font->glyphs, 0, sizeof(wplSdfGlyph) * count);
+	font->unitScale = scale;
+	wplPopulateKerning(info, &font->kern, arena);
+
+	i32 ascent, descent, lineGap;
+	stbtt_GetFontVMetrics(info, &ascent, &descent, &lineGap);
+	font->ascent = ascent * scale;
+	font->lineHeight = (ascent - descent + lineGap) * scale;
+
+	MemoryArena* scratch = arenaThreadScratch();
+	ArenaCheckpoint cp = arenaCheckpoint(scratch);
+	u8** fields = arenaPush(scratch, sizeof(u8*) * count);
+	stbrp_rect* rects = arenaPush(scratch, sizeof(stbrp_rect) * count);
+
+	for(i32 i = 0; i < count; ++i) {
+		wplSdfGlyph* g = font->glyphs + i;
+		i32 advance, leftSideBearing;
+		stbtt_GetCodepointHMetrics(info, first + i, &advance, &leftSideBearing);
+		g->advance = advance * scale;
+		g->index = stbtt_FindGlyphIndex(info, first + i);
+
+		// 128 is the edge, and the field runs out WPL_SDF_SPREAD texels 
+		// either side of it
+		i32 w = 0, h = 0, xoff = 0, yoff = 0;
+		fields[i] = stbtt_GetCodepointSDF(info, scale, first + i,
+				WPL_SDF_SPREAD, 128, 128.0f / WPL_SDF_SPREAD,
+				&w, &h, &xoff, &yoff);
+		if(!fields[i]) w = h = 0;
+		g->tw = w;
+		g->th = h;
+		g->xoff = xoff;
+		g->yoff = yoff;
+
+		// 1px gap so filtering doesn't pick up the neighbours
+		rects[i].id = i;
+		rects[i].w = w ? w + 1 : 0;
+		rects[i].h = h ? h + 1 : 0;
+	}
+
+	i32 size = 128;
+	stbrp_node* nodes = arenaPush(scratch, sizeof(stbrp_node) * 4096);
+	stbrp_context context;
+	while(1) {
+		for(i32 i = 0; i < count; ++i) {
+			rects[i].was_packed = 0;
+		}
+		stbrp_init_target(&context, size, size, nodes, size);
+		if(stbrp_pack_rects(&context, rects, count)) break;
+		if(size == 4096) break;
+		size *= 2;
+	}
+
+	wplTexture* texture = arenaPush(arena, sizeof(wplTexture));
+	memset(texture, 0, sizeof(wplTexture));
+	texture->w = size;
+	texture->h = size;
+	texture->pixels = arenaPush(arena, size * size * 4);
+	memset(texture->pixels, 0, size * size * 4);
+	font->texture = texture;
+
+	// White, with the distance in alpha
+	u32* pixels = (u32*)texture->pixels;
+	for(i32 i = 0; i < count; ++i) {
+		stbrp_rect* r = rects + i;
+		wplSdfGlyph* g = font->glyphs + r->id;
+		u8* field = fields[r->id];
+		if(!field) continue;
+		if(!r->was_packed) {
+			g->tw = g->th = 0;
+		} else {
+			g->tx = r->x;
+			g->ty = r->y;
+			for(i32 y = 0; y < g->th; ++y) {
+				u32* row = pixels + (r->y + y) * size + r->x;
+				u8* src = field + y * g->tw;
+				for(i32 x = 0; x < g->tw; ++x) {
+					row[x] = ((u32)src[x] << 24) | 0x00FFFFFF;
+				}
+			}
+		}
+		stbtt_FreeSDF(field, info->userdata);
+	}
+
+	arenaRewind(cp);
+	return font;
+}
+
+/* Draws text pixelHeight tall with its top left at x, y; returns the 
+ * width of the widest line */
+f32 wplDrawSdfText(wplRenderGroup* group, wplSdfFont* font,
+		string text, f32 x, f32 y, f32 pixelHeight, u32 color)
+{
+	f32 k = pixelHeight / font->size;
+	f32 penX = x, baseline = y + font->ascent * k;
+	f32 width = 0;
+	wplSdfGlyph* last = NULL;
+	for(isize i = 0; text[i]; ++i) {
+		if(text[i] == '\n') {
+			if(penX - x > width) width = penX - x;
+			penX = x;
+			baseline += font->lineHeight * k;
+			last = NULL;
+			continue;
+		}
+		i32 c = (u8)text[i] - font->first;
+		if(c < 0 || c >= font->count) continue;
+		wplSdfGlyph* g = font->glyphs + c;
+		if(last) {
+			penX += wplGetKerning(&font->kern, last->index, g->index) *
+				font->unitScale * k;
+		}
+		last = g;
+		if(g->tw) {
+			wplSprite* s = wplGroupAdd(group, Anchor_TopLeft | Sprite_Sdf,
+					penX + g->xoff * k, baseline + g->yoff * k,
+					g->tw * k, g->th * k,
+					g->tx, g->ty, g->tw, g->th);
+			s->color = color;
+		}
+		penX += g->advance * k;
+	}
+	if(penX - x > width) width = penX - x;
+	return width;
+}
 #endif
 
 void wplQuit()
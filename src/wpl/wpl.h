@@ -1,7 +1,11 @@
 #pragma once 
 
 #include <stdint.h>
+#ifdef _MSC_VER
 #include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 #include "wplDefines.h"
 #define WB_ALLOC_CUSTOM_INTEGER_TYPES
 #define WB_ALLOC_API extern
@@ -0,0 +1,178 @@
+/* Formatting for the UI's hot paths. A wplFormat is a format string split
+ * once into literal pieces and arguments, so formatting with one is just
+ * copies and integer conversions, with none of printf's parsing or locale
+ * handling. Only %d, %i, %s, %c and %% (with a width and zero padding on
+ * the integers) are handled here; anything else goes to vsnprintf. */
+
+static const char wplDigitPairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/* Writes value into out, not terminated, padded to width; returns the
+ * length. out needs room for max(width, 20) chars */
+isize wplFormatInt(char* out, i64 value, i32 width, i32 zeroPad)
+{
+	char digits[24];
+	char* d = digits + 24;
+	u64 v = value < 0 ? (u64)0 - (u64)value : (u64)value;
+	while(v >= 100) {
+		u64 pair = (v % 100) * 2;
+		v /= 100;
+		*--d = wplDigitPairs[pair + 1];
+		*--d = wplDigitPairs[pair];
+	}
+	if(v >= 10) {
+		*--d = wplDigitPairs[v * 2 + 1];
+		*--d = wplDigitPairs[v * 2];
+	} else {
+		*--d = (char)('0' + v);
+	}
+	isize count = digits + 24 - d;
+
+	isize len = 0;
+	isize sign = value < 0;
+	isize pad = width - count - sign;
+	if(!zeroPad) {
+		for(; pad > 0; --pad) out[len++] = ' ';
+	}
+	if(sign) out[len++] = '-';
+	for(; pad > 0; --pad) out[len++] = '0';
+	memcpy(out + len, d, count);
+	return len + count;
+}
+
+static
+void formatAddPiece(wplFormat* f, i32 kind, isize start, isize len)
+{
+	if(kind == Format_Literal && len == 0) return;
+	if(f->pieceCount == WPL_FORMAT_PIECES) {
+		f->fallback = 1;
+		return;
+	}
+	wplFormatPiece* p = f->pieces + f->pieceCount++;
+	p->kind = kind;
+	p->start = (i32)start;
+	p->len = (i32)len;
+	p->width = 0;
+	p->zeroPad = 0;
+}
+
+void wplFormatCompile(wplFormat* f)
+{
+	string s = f->fmt;
+	f->compiled = 1;
+	f->fallback = 0;
+	f->pieceCount = 0;
+	isize i = 0, literal = 0;
+	while(s[i] && !f->fallback) {
+		if(s[i] != '%') {
+			i++;
+			continue;
+		}
+		formatAddPiece(f, Format_Literal, literal, i - literal);
+		i++;
+		if(s[i] == '%') {
+			// The second % starts the next literal
+			literal = i++;
+			continue;
+		}
+
+		i32 zeroPad = 0, width = 0;
+		if(s[i] == '0') {
+			zeroPad = 1;
+			i++;
+		}
+		while(s[i] >= '0' && s[i] <= '9') {
+			if(width < 1000) width = width * 10 + (s[i] - '0');
+			i++;
+		}
+
+		i32 kind;
+		switch(s[i]) {
+			case 'd': case 'i': kind = Format_Int; break;
+			case 's': kind = Format_String; break;
+			case 'c': kind = Format_Char; break;
+			default: kind = -1; break;
+		}
+		if(kind == -1 || width > 64 || 
+				(kind != Format_Int && (width || zeroPad))) {
+			f->fallback = 1;
+			break;
+		}
+		formatAddPiece(f, kind, 0, 0);
+		if(!f->fallback) {
+			f->pieces[f->pieceCount - 1].width = width;
+			f->pieces[f->pieceCount - 1].zeroPad = zeroPad;
+		}
+		literal = ++i;
+	}
+	formatAddPiece(f, Format_Literal, literal, i - literal);
+}
+
+static inline
+void formatPut(char* out, isize cap, isize* len, const char* s, isize count)
+{
+	isize room = cap - *len;
+	if(room > 0) {
+		memcpy(out + *len, s, count < room ? count : room);
+	}
+	*len += count;
+}
+
+/* Like vsnprintf: writes at most cap chars, terminated if cap > 0, and
+ * returns the full length */
+static
+isize formatWrite(wplFormat* f, char* out, isize cap, va_list args)
+{
+	isize len = 0;
+	for(i32 i = 0; i < f->pieceCount; ++i) {
+		wplFormatPiece* p = f->pieces + i;
+		switch(p->kind) {
+			case Format_Literal:
+				formatPut(out, cap, &len, f->fmt + p->start, p->len);
+				break;
+			case Format_Int: {
+				char digits[88];
+				isize count = wplFormatInt(digits, va_arg(args, int),
+						p->width, p->zeroPad);
+				formatPut(out, cap, &len, digits, count);
+			} break;
+			case Format_String: {
+				const char* s = va_arg(args, const char*);
+				if(!s) s = "(null)";
+				formatPut(out, cap, &len, s, strlen(s));
+			} break;
+			case Format_Char: {
+				char c = (char)va_arg(args, int);
+				formatPut(out, cap, &len, &c, 1);
+			} break;
+		}
+	}
+	if(cap > 0) {
+		out[len < cap ? len : cap - 1] = '\0';
+	}
+	return len;
+}
+
+/* Formats into a buffer, for text that doesn't need to outlive the call */
+isize wplFormatTo(char* out, isize cap, wplFormat* f, ...)
+{
+	if(!f->compiled) {
+		wplFormatCompile(f);
+	}
+	va_list args;
+	va_start(args, f);
+	isize len = f->fallback ?
+		vsnprintf(out, cap, f->fmt, args) :
+		formatWrite(f, out, cap, args);
+	va_end(args);
+	return len;
+}
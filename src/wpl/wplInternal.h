@@ -2,15 +2,29 @@ typedef struct wplWindowDef wplWindowDef;
 typedef struct wplWindow wplWindow;
 typedef struct wplInputState wplInputState;
 typedef struct wplState wplState;
+typedef struct wplSoftTarget wplSoftTarget;
 
 typedef struct wplSprite wplSprite;
+typedef struct wplPackedSprite wplPackedSprite;
+typedef struct wplGlyphSprite wplGlyphSprite;
+typedef struct wplGlyphTable wplGlyphTable;
+typedef struct wplGlyphSpan wplGlyphSpan;
+typedef struct wplFormat wplFormat;
+typedef struct wplFormatPiece wplFormatPiece;
 typedef struct wplVertex wplVertex;
 typedef struct wplRenderGroup wplRenderGroup;
+typedef struct wplBatchRun wplBatchRun;
+typedef struct wplBatch wplBatch;
+typedef struct wplDrawTiming wplDrawTiming;
+typedef struct wplProfile wplProfile;
 typedef struct wplShader wplShader;
 typedef struct wplTexture wplTexture;
 
 typedef struct wplGlyph wplGlyph;
+typedef struct wplKernPair wplKernPair;
 typedef struct wplKerning wplKerning;
+typedef struct wplSdfGlyph wplSdfGlyph;
+typedef struct wplSdfFont wplSdfFont;
 
 typedef const char* string;
 
@@ -31,6 +45,10 @@ struct wplWindowDef
 	i64 resizeable;
 	i64 borderless;
 	i64 hidden;
+
+	// No window or GL context; sprites are drawn by the software 
+	// rasterizer into window->soft
+	i64 headless;
 };
 
 struct wplWindow
@@ -42,6 +60,21 @@ struct wplWindow
 	u8* basePath;
 	const u8 *vertShader, *fragShader;
 	void* windowHandle;
+	wplSoftTarget* soft;
+
+	// Two frame arenas, swapped and rewound at the start of wplUpdate,
+	// so frame memory stays valid until the end of the next frame
+	MemoryArena* frameArenas[2];
+	ArenaCheckpoint frameStarts[2];
+	i64 frameIndex;
+};
+
+struct wplSoftTarget
+{
+	i64 w, h;
+	// RGBA8, top row first, so it can go straight to wplWriteImage
+	u32* pixels;
+	u32 clearColor;
 };
 
 struct wplInputState
@@ -73,6 +106,60 @@ struct wplSprite
 	f32 angle;
 };
 
+/* The batch's compact instance, 24 bytes to wplSprite's 40. Position 
+ * and size are in 1/WPL_PACKED_UNIT steps, angle in 1/65536ths of a turn
+ * about the sprite's position. Runs with anything that doesn't fit 
+ * exactly (other than angle precision) are sent as full wplSprites. */
+#define WPL_PACKED_UNIT 8
+
+struct wplPackedSprite
+{
+	i16 x, y;
+	u16 w, h;
+	i16 tx, ty, tw, th;
+	u32 color;
+	u16 flags, angle;
+};
+
+/* Text's instance, 12 bytes. A group with a glyph table gets its glyphs
+ * sent like this, and the shader looks their rect up in uGlyphs; size is
+ * the rect's times scale / WPL_GLYPH_SCALE. Stretches of glyphs shorter
+ * than WPL_GLYPH_MIN_RUN stay packed, so text mixed in with other sprites
+ * doesn't split into lots of draws. */
+#define WPL_MAX_GLYPHS 128
+#define WPL_GLYPH_SCALE 16
+#define WPL_GLYPH_MIN_RUN 16
+
+struct wplGlyphSprite
+{
+	i16 x, y;
+	u8 glyph, scale;
+	u16 flags;
+	u32 color;
+};
+
+struct wplGlyphTable
+{
+	i32 rects[WPL_MAX_GLYPHS][4];
+	i32 count;
+	// Index + 1 by texture position, for finding a sprite's glyph
+	u8 lookup[256];
+};
+
+/* A stretch of a group's sprites that came with their glyph instances
+ * already made; see wplGroupAttachGlyphs */
+struct wplGlyphSpan
+{
+	i64 start, count;
+};
+
+enum wplInstanceFormat
+{
+	Instance_Sprite,
+	Instance_Packed,
+	Instance_Glyph
+};
+
 struct wplVertex
 {
 	f32 x, y, u, v;
@@ -91,6 +178,10 @@ struct wplShader
 	i32 uScale;
 	i32 uOffset;
 	i32 uViewport;
+	i32 uTextureOffset;
+	i32 uUnpack;
+	i32 uGlyphs;
+	i32 uGlyphMode;
 };
 
 struct wplTexture
@@ -98,8 +189,33 @@ struct wplTexture
 	i64 w, h;
 	u8* pixels;
 	u32 glIndex;
+
+	// Set when the texture has been packed into an atlas; its pixels 
+	// live at atlasX, atlasY in there
+	wplTexture* atlas;
+	i32 atlasX, atlasY;
+
+	// wplTextureStatus; anything but Texture_Ready is still on its way
+	// through the async loader, which also owns the fields below
+	volatile i32 status;
+	i64 uploadedRows;
+	u32 uploadBuffer;
+};
+
+enum wplTextureStatus
+{
+	Texture_Ready = 0,
+	Texture_Decoding,
+	Texture_Decoded,
+	Texture_Uploading,
+	Texture_Failed
 };
 
+// The instance ring is split into this many segments, each big enough
+// for this many full draws of the group
+#define WPL_RING_SEGMENTS 3
+#define WPL_RING_DRAWS 4
+
 struct wplRenderGroup
 {
 	wplTexture* texture;
@@ -112,11 +228,115 @@ struct wplRenderGroup
 	f32 scale;
 	f32 offsetX, offsetY;
 	u32 tint;
+	wplGlyphTable* glyphs;
+	// Glyph instances for the spans of sprites that have them, at the
+	// same index as their sprite
+	wplGlyphSprite* glyphSprites;
+	wplGlyphSpan* glyphSpans;
+	i64 glyphSpanCount, glyphSpanCapacity;
 
 	wplSprite* sprites;
 	wplVertex* verts;
 	i32 *indices, *vertCounts;
 	i64 count, capacity, lastFilled;
+
+	// Groups double out of their arena when they fill up; grows counts
+	// how many times that's happened
+	MemoryArena* arena;
+	i64 grows;
+
+	// When the GL supports ARB_buffer_storage, sprites points straight
+	// into a persistently mapped ring; otherwise (and for groups that 
+	// don't clearOnDraw) it points at localSprites
+	wplSprite *localSprites, *ring;
+	void* ringFences[WPL_RING_SEGMENTS];
+	i64 ringSegment, ringHead, ringSegmentSize;
+
+	// Retained groups (clearOnDraw == 0) keep their sprites across 
+	// frames, with a copy on the GPU in retainedVbo. Only the range 
+	// touched since the last draw, [dirtyStart, dirtyEnd), gets re-sent
+	u32 retainedVbo;
+	i64 retainedCapacity;
+	i64 dirtyStart, dirtyEnd;
+	// What the basic path's vertices were last built against
+	f32 builtScale, builtOffsetX, builtOffsetY;
+	i64 builtWidth, builtHeight;
+};
+
+/* A frame-level sprite queue. Groups are submitted with a layer instead
+ * of drawn; at flush time runs are sorted by a 64-bit key of
+ * layer | texture | scale | submit order, and neighbouring runs that share
+ * all their draw state are merged into a single instanced draw. */
+#define WPL_BATCH_MAX_RUNS 256
+
+struct wplBatchRun
+{
+	u64 key;
+	wplTexture* texture;
+	f32 scale;
+	f32 offsetX, offsetY;
+	u32 tint;
+	f32 textureX, textureY;
+	i64 start, count;
+	// Where the run's instances landed in the stream, in bytes, and
+	// their wplInstanceFormat
+	isize offset;
+	i32 format;
+	wplGlyphTable* glyphs;
+
+	// Retained groups draw straight from their own buffer
+	wplRenderGroup* retained;
+};
+
+struct wplBatch
+{
+	wplWindow* window;
+	wplState* state;
+
+	// Sprites are staged here at submit, then gathered in key order into
+	// the stream group, which owns the vao/vbo (and ring, if any)
+	wplRenderGroup stream;
+	wplSprite* sprites;
+	i64 count, capacity;
+
+	wplBatchRun runs[WPL_BATCH_MAX_RUNS];
+	i64 runCount;
+
+	// Counts for the current frame, and the last finished one. Spills
+	// are early draws made because the stream ran out of room
+	i64 drawCalls, stateChanges, culled, submitted, spills, uploaded;
+	i64 lastDrawCalls, lastStateChanges, lastCulled, lastSubmitted, lastSpills;
+	i64 lastUploaded;
+};
+
+// GPU timings are read back this many frames after they're issued
+#define WPL_PROFILE_LATENCY 4
+#define WPL_PROFILE_DRAWS 64
+#define WPL_PROFILE_HISTORY 120
+
+struct wplDrawTiming
+{
+	// The batch layer, or -1 for groups drawn directly
+	i32 layer;
+	i64 sprites;
+	f32 gpuMs;
+};
+
+/* Timings in milliseconds, filled in while profiling is enabled. The CPU
+ * ones are from the last frame; the GPU ones lag WPL_PROFILE_LATENCY 
+ * frames behind. */
+struct wplProfile
+{
+	i32 enabled;
+	f32 frameMs, platformMs, gameMs, renderMs;
+	f32 gpuMs;
+	wplDrawTiming draws[WPL_PROFILE_DRAWS];
+	i32 drawCount;
+
+	// Ring of frame and GPU times; historyHead is the oldest
+	f32 history[WPL_PROFILE_HISTORY];
+	f32 gpuHistory[WPL_PROFILE_HISTORY];
+	i32 historyHead;
 };
 
 enum SpriteFlags
@@ -137,6 +357,9 @@ enum SpriteFlags
 	Sprite_FlipHoriz = 1<<8,
 	Sprite_FlipVert = 1<<9,
 	Sprite_Circle = 1<<10,
+	// The texture's alpha is a distance field (see wplCreateSdfFont),
+	// thresholded at 0.5 rather than blended
+	Sprite_Sdf = 1<<11,
 	Sprite_NoAA = 1<<13,
 };
 
@@ -158,10 +381,51 @@ struct wplGlyph
 	void* userdata;
 };
 
+struct wplKernPair
+{
+	// glyph1 << 16 | glyph2; 0 is an empty slot
+	u32 key;
+	i32 advance;
+};
+
+struct wplKerning
+{
+	wplKernPair* pairs;
+	u32 count, capacity;
+};
+
 struct wplFont
 {
 	f32 scale;
-	i32 kern[256][256];
+	wplKerning kern;
+};
+
+// Distances in an SDF atlas go from 0 to 1 over this many texels either
+// side of the glyph's edge, which sits at 0.5
+#define WPL_SDF_SPREAD 6
+
+struct wplSdfGlyph
+{
+	// Atlas rect, and where it goes relative to the pen at baseline,
+	// all in atlas texels
+	i16 tx, ty, tw, th;
+	f32 xoff, yoff;
+	f32 advance;
+	i32 index;
+};
+
+struct wplSdfFont
+{
+	wplTexture* texture;
+	// The pixel height the atlas was rendered at; drawing at another
+	// size just scales the quads
+	f32 size;
+	f32 ascent, lineHeight;
+	i32 first, count;
+	wplSdfGlyph* glyphs;
+	// Font units to atlas texels, for the kerning
+	f32 unitScale;
+	wplKerning kern;
 };
 
 
@@ -170,6 +434,62 @@ i64 wplCreateWindow(wplWindowDef* def, wplWindow* window);
 void wplShowWindow();
 i64 wplUpdate(wplWindow* window, wplState* state);
 i64 wplRender(wplWindow* window);
+void wplSleep(i32 ms);
+
+wplSoftTarget* wplSoftCreateTarget(i64 w, i64 h, MemoryArena* arena);
+void wplSoftClear(wplSoftTarget* target);
+void wplSoftDrawGroup(wplSoftTarget* target, wplRenderGroup* group);
+void wplSoftWriteImage(wplSoftTarget* target, string filename);
+i64 wplSoftCompareImage(wplSoftTarget* target, string filename, i32 tolerance, i32* maxDiff);
+
+wplTexture* wplLoadTextureAsync(wplWindow* window, string filename, MemoryArena* arena);
+void wplUploadTextureAsync(wplTexture* texture);
+i32 wplTexturesDecoded(wplTexture** textures, i64 count);
+i32 wplTextureReady(wplTexture* texture);
+
+i64 wplInit();
+void wplStartupMark(string label);
+void wplStartupPrint(void);
+void wplProfileEnable(wplWindow* window, i32 enabled);
+wplProfile* wplGetProfile(void);
+f64 wplGetTimeMs(void);
+
+/* A format string split into pieces once, for wplFrameFormat; declare
+ * one static with just fmt set and it's split on first use */
+#define WPL_FORMAT_PIECES 16
+
+enum wplFormatKind
+{
+	Format_Literal,
+	Format_Int,
+	Format_String,
+	Format_Char
+};
+
+struct wplFormatPiece
+{
+	i32 kind;
+	// Literals are the range [start, start + len) of fmt
+	i32 start, len;
+	i16 width, zeroPad;
+};
+
+struct wplFormat
+{
+	string fmt;
+	i32 compiled;
+	// Uses something we don't handle; formatted by vsnprintf instead
+	i32 fallback;
+	i32 pieceCount;
+	wplFormatPiece pieces[WPL_FORMAT_PIECES];
+};
+
+void* wplFrameAlloc(isize size);
+char* wplFramePrintf(const char* fmt, ...);
+char* wplFrameFormat(wplFormat* f, ...);
+isize wplFormatTo(char* out, isize cap, wplFormat* f, ...);
+isize wplFormatInt(char* out, i64 value, i32 width, i32 zeroPad);
+void wplFormatCompile(wplFormat* f);
 
 i64 wplKeyIsDown(i64 keycode);
 i64 wplKeyIsUp(i64 keycode);
@@ -194,13 +514,18 @@ void wplWriteImage(string filename, i64 w, i64 h, void* data);
 u8* wplReadEntireFile(char* filename, isize* size_out, MemoryArena* arena);
 
 #ifdef WPL_FONT
-void wplPopulateKerning(void* info, wplKerning* k, isize start, isize end);
+void wplPopulateKerning(void* info, wplKerning* k, MemoryArena* arena);
+i32 wplGetKerning(wplKerning* k, i32 glyph1, i32 glyph2);
 i32 wplGetGlyphIndexFromCodepoint(void* info, i32 codepoint);
 void wplPopulateGlyph(void* info, i32 index, wplGlyph* glyph, f32 scale);
 void* wplRenderGlyph(void* fontInfo, wplGlyph* glyph, MemoryArena* arena);
 void* wplCreateFontContext(void* font, MemoryArena* arena);
 void* wplLoadFont(wplWindow* window, string filename, MemoryArena* arena);
 f32 wplGetFontScale(void* font, i64 pixels);
+wplSdfFont* wplCreateSdfFont(void* fontInfo, f32 pixelHeight,
+		i32 first, i32 count, MemoryArena* arena);
+f32 wplDrawSdfText(wplRenderGroup* group, wplSdfFont* font,
+		string text, f32 x, f32 y, f32 pixelHeight, u32 color);
 #endif
 
 wplSprite* wplGroupAdd(wplRenderGroup* group, 
@@ -210,11 +535,22 @@ wplSprite* wplGroupAdd(wplRenderGroup* group,
 		i16 tx, i16 ty, i16 tw, i16 th);
 
 wplSprite* wplGetSprite(wplRenderGroup* group);
+wplSprite* wplGroupAddSprites(wplRenderGroup* group, i64 count);
+void wplGroupAttachGlyphs(wplRenderGroup* group, wplGlyphSprite* glyphs, i64 count, i32 x, i32 y);
+wplGlyphTable* wplCreateGlyphTable(i16* rects, i32 count, MemoryArena* arena);
+wplSprite* wplGroupEdit(wplRenderGroup* group, i64 index);
+void wplGroupTouch(wplRenderGroup* group, i64 start, i64 end);
+void wplGroupClear(wplRenderGroup* group);
+void wplGroupSetRetained(wplRenderGroup* group, i32 retained);
 void wplGroupInit(wplWindow* window, wplRenderGroup* group, i64 cap, wplShader* shader, wplTexture* texture, MemoryArena* arena);
 void wplGroupDrawBasic(wplState* state, wplRenderGroup* group);
 void wplGroupDraw(wplWindow* window, wplState* state, wplRenderGroup* group);
+void wplBatchInit(wplWindow* window, wplBatch* batch, i64 cap, wplShader* shader, MemoryArena* arena);
+void wplBatchSubmit(wplWindow* window, wplState* state, wplBatch* batch, wplRenderGroup* group, i32 layer);
+void wplBatchFlush(wplBatch* batch);
 void wplUploadTexture(wplTexture* texture);
 wplTexture* wplLoadTexture(wplWindow* window, string filename, MemoryArena* arena);
+wplTexture* wplPackAtlas(wplTexture** images, i64 count, i64 maxSize, MemoryArena* arena);
 
 
 
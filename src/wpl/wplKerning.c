@@ -0,0 +1,261 @@
+/* Kerning, read straight out of the font's pair lists rather than asked
+ * for one pair at a time. Pairs go into an open-addressed hash keyed by
+ * (glyph1 << 16 | glyph2), so any codepoint the font covers can kern and
+ * a lookup is a probe or two. Like stbtt_GetGlyphKernAdvance, GPOS wins
+ * when the font has it, and the kern table is only used otherwise. */
+
+static inline
+u16 kernU16(const u8* p)
+{
+	return (u16)((p[0] << 8) | p[1]);
+}
+
+static inline
+u32 kernU32(const u8* p)
+{
+	return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+}
+
+static inline
+u32 kernHash(u32 key)
+{
+	return key * 2654435761u;
+}
+
+/* With no table yet this only counts, which sizes the table for the
+ * second pass. The first value a pair gets is the one that's kept, even
+ * 0: fonts list zero pairs ahead of class kerning to cancel it. */
+static
+void kernAdd(wplKerning* k, u32 glyph1, u32 glyph2, i32 advance)
+{
+	u32 key = (glyph1 << 16) | glyph2;
+	// 0 marks an empty slot; .notdef never kerns against itself anyway
+	if(key == 0) return;
+	if(!k->pairs) {
+		k->count++;
+		return;
+	}
+	u32 mask = k->capacity - 1;
+	for(u32 i = kernHash(key) & mask; ; i = (i + 1) & mask) {
+		wplKernPair* p = k->pairs + i;
+		if(p->key == key) return;
+		if(p->key == 0) {
+			p->key = key;
+			p->advance = advance;
+			k->count++;
+			return;
+		}
+	}
+}
+
+i32 wplGetKerning(wplKerning* k, i32 glyph1, i32 glyph2)
+{
+	if(!k->capacity) return 0;
+	u32 key = ((u32)glyph1 << 16) | (u32)glyph2;
+	u32 mask = k->capacity - 1;
+	for(u32 i = kernHash(key) & mask; ; i = (i + 1) & mask) {
+		wplKernPair* p = k->pairs + i;
+		if(p->key == key) return p->advance;
+		if(p->key == 0) return 0;
+	}
+}
+
+/* Format 0 subtables, horizontal and not cross-stream */
+static
+void kernWalkKern(const u8* table, wplKerning* k)
+{
+	if(kernU16(table) != 0) return;
+	i32 subtables = kernU16(table + 2);
+	const u8* sub = table + 4;
+	for(i32 i = 0; i < subtables; ++i) {
+		u16 length = kernU16(sub + 2);
+		u16 coverage = kernU16(sub + 4);
+		if((coverage >> 8) == 0 && (coverage & 0x5) == 0x1) {
+			i32 pairs = kernU16(sub + 6);
+			const u8* pair = sub + 14;
+			for(i32 j = 0; j < pairs; ++j, pair += 6) {
+				kernAdd(k, kernU16(pair), kernU16(pair + 2),
+						(i16)kernU16(pair + 4));
+			}
+		}
+		sub += length;
+	}
+}
+
+static
+i32 kernBitCount(u16 v)
+{
+	i32 n = 0;
+	for(; v; v &= v - 1) n++;
+	return n;
+}
+
+/* Where XAdvance sits in a value record, or -1 if it doesn't have one */
+static
+i32 kernXAdvanceOffset(u16 valueFormat)
+{
+	if(!(valueFormat & 0x4)) return -1;
+	return kernBitCount(valueFormat & 0x3) * 2;
+}
+
+/* Class 0 is every glyph the table doesn't list, which isn't worth
+ * expanding; class 0 pairs are almost always zero anyway */
+static
+i32 kernClassOf(const u8* classDef, u32 glyph)
+{
+	u16 format = kernU16(classDef);
+	if(format == 1) {
+		u32 start = kernU16(classDef + 2);
+		u32 count = kernU16(classDef + 4);
+		if(glyph >= start && glyph < start + count) {
+			return kernU16(classDef + 6 + (glyph - start) * 2);
+		}
+	} else if(format == 2) {
+		i32 lo = 0, hi = kernU16(classDef + 2) - 1;
+		while(lo <= hi) {
+			i32 mid = (lo + hi) / 2;
+			const u8* range = classDef + 4 + mid * 6;
+			if(glyph < kernU16(range)) {
+				hi = mid - 1;
+			} else if(glyph > kernU16(range + 2)) {
+				lo = mid + 1;
+			} else {
+				return kernU16(range + 4);
+			}
+		}
+	}
+	return 0;
+}
+
+/* All of first glyph's pairs in a PairPos subtable; index is where it
+ * sits in the coverage table */
+static
+void kernWalkPairs(const u8* sub, u32 glyph1, u32 index,
+		i32 recordSize, i32 xAdvance, wplKerning* k)
+{
+	if(kernU16(sub) == 1) {
+		const u8* set = sub + kernU16(sub + 10 + index * 2);
+		i32 count = kernU16(set);
+		const u8* pair = set + 2;
+		for(i32 i = 0; i < count; ++i, pair += 2 + recordSize) {
+			kernAdd(k, glyph1, kernU16(pair),
+					(i16)kernU16(pair + 2 + xAdvance));
+		}
+		return;
+	}
+
+	// Format 2: look up glyph1's row of the class matrix, then pair it
+	// with every glyph the second class def lists
+	const u8* classDef1 = sub + kernU16(sub + 8);
+	const u8* classDef2 = sub + kernU16(sub + 10);
+	i32 class2Count = kernU16(sub + 14);
+	const u8* row = sub + 16 +
+		kernClassOf(classDef1, glyph1) * class2Count * recordSize;
+
+	u16 format = kernU16(classDef2);
+	i32 count = kernU16(classDef2 + (format == 1 ? 4 : 2));
+	for(i32 i = 0; i < count; ++i) {
+		u32 first, last;
+		i32 c2;
+		if(format == 1) {
+			first = last = kernU16(classDef2 + 2) + i;
+			c2 = kernU16(classDef2 + 6 + i * 2);
+		} else if(format == 2) {
+			const u8* range = classDef2 + 4 + i * 6;
+			first = kernU16(range);
+			last = kernU16(range + 2);
+			c2 = kernU16(range + 4);
+		} else {
+			return;
+		}
+		if(c2 == 0 || c2 >= class2Count) continue;
+		i32 advance = (i16)kernU16(row + c2 * recordSize + xAdvance);
+		for(u32 g = first; g <= last; ++g) {
+			kernAdd(k, glyph1, g, advance);
+		}
+	}
+}
+
+static
+void kernWalkPairPos(const u8* sub, wplKerning* k)
+{
+	u16 format = kernU16(sub);
+	if(format != 1 && format != 2) return;
+	u16 valueFormat1 = kernU16(sub + 4);
+	u16 valueFormat2 = kernU16(sub + 6);
+	i32 xAdvance = kernXAdvanceOffset(valueFormat1);
+	if(xAdvance < 0) return;
+	i32 recordSize = (kernBitCount(valueFormat1) + kernBitCount(valueFormat2)) * 2;
+
+	// Coverage lists the first glyphs, either one by one or as ranges
+	const u8* coverage = sub + kernU16(sub + 2);
+	u16 coverageFormat = kernU16(coverage);
+	i32 count = kernU16(coverage + 2);
+	if(coverageFormat == 1) {
+		for(i32 i = 0; i < count; ++i) {
+			kernWalkPairs(sub, kernU16(coverage + 4 + i * 2), i,
+					recordSize, xAdvance, k);
+		}
+	} else if(coverageFormat == 2) {
+		for(i32 i = 0; i < count; ++i) {
+			const u8* range = coverage + 4 + i * 6;
+			u32 first = kernU16(range);
+			u32 last = kernU16(range + 2);
+			u32 index = kernU16(range + 4);
+			for(u32 g = first; g <= last; ++g) {
+				kernWalkPairs(sub, g, index + g - first,
+						recordSize, xAdvance, k);
+			}
+		}
+	}
+}
+
+/* Pair adjustment lookups (type 2), including ones behind an extension
+ * (type 9) */
+static
+void kernWalkGpos(const u8* table, wplKerning* k)
+{
+	if(kernU16(table) != 1) return;
+	const u8* lookups = table + kernU16(table + 8);
+	i32 lookupCount = kernU16(lookups);
+	for(i32 i = 0; i < lookupCount; ++i) {
+		const u8* lookup = lookups + kernU16(lookups + 2 + i * 2);
+		u16 type = kernU16(lookup);
+		i32 subtables = kernU16(lookup + 4);
+		for(i32 j = 0; j < subtables; ++j) {
+			const u8* sub = lookup + kernU16(lookup + 6 + j * 2);
+			if(type == 9 && kernU16(sub + 2) == 2) {
+				kernWalkPairPos(sub + kernU32(sub + 4), k);
+			} else if(type == 2) {
+				kernWalkPairPos(sub, k);
+			}
+		}
+	}
+}
+
+static
+void kernWalk(stbtt_fontinfo* info, wplKerning* k)
+{
+	if(info->gpos) {
+		kernWalkGpos(info->data + info->gpos, k);
+	} else if(info->kern) {
+		kernWalkKern(info->data + info->kern, k);
+	}
+}
+
+/* Counts the font's pairs, then fills a table at most 3/4 full. The
+ * advances are in font units, like stbtt_GetGlyphKernAdvance's. */
+void wplPopulateKerning(void* info, wplKerning* k, MemoryArena* arena)
+{
+	memset(k, 0, sizeof(wplKerning));
+	kernWalk(info, k);
+	if(k->count == 0) return;
+
+	u32 capacity = 16;
+	while(capacity * 3 < k->count * 4) capacity *= 2;
+	k->capacity = capacity;
+	k->pairs = arenaPush(arena, sizeof(wplKernPair) * capacity);
+	memset(k->pairs, 0, sizeof(wplKernPair) * capacity);
+	k->count = 0;
+	kernWalk(info, k);
+}
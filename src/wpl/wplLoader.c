@@ -0,0 +1,274 @@
+/* Background texture loading. wplLoadTextureAsync hands back a texture
+ * straight away and decodes the file on a loader thread. Textures queued
+ * with wplUploadTextureAsync are sent up through a pixel buffer a slice
+ * of rows at a time in wplUpdate, at most WPL_UPLOAD_BUDGET bytes a frame.
+ * Until a texture's status is Texture_Ready, groups using it are skipped. */
+
+#define WPL_LOAD_QUEUE 256
+#define WPL_LOADERS 4
+#define WPL_UPLOAD_BUDGET (4 << 20)
+
+typedef struct wplLoadJob wplLoadJob;
+struct wplLoadJob
+{
+	wplTexture* texture;
+	char path[1024];
+};
+
+struct wplLoader
+{
+	i32 initialized;
+	SDL_mutex* lock;
+	SDL_sem* jobCount;
+	wplLoadJob jobs[WPL_LOAD_QUEUE];
+	i64 jobHead, jobTail;
+
+	// Main thread only; the upload queue doubles when it fills
+	MemoryArena* arena;
+	wplTexture** uploads;
+	i64 uploadCount, uploadCapacity;
+};
+
+static struct wplLoader wplLoader;
+
+static
+void loaderDecode(wplTexture* texture, const char* path)
+{
+	i32 w = 0, h = 0, bpp;
+	u8* data = stbi_load(path, &w, &h, &bpp, STBI_rgb_alpha);
+	texture->w = w;
+	texture->h = h;
+	texture->pixels = data;
+	SDL_MemoryBarrierRelease();
+	texture->status = data ? Texture_Decoded : Texture_Failed;
+}
+
+static
+int loaderMain(void* data)
+{
+	while(1) {
+		SDL_SemWait(wplLoader.jobCount);
+		SDL_LockMutex(wplLoader.lock);
+		wplLoadJob job = wplLoader.jobs[wplLoader.jobTail % WPL_LOAD_QUEUE];
+		wplLoader.jobTail++;
+		SDL_UnlockMutex(wplLoader.lock);
+		loaderDecode(job.texture, job.path);
+	}
+	return 0;
+}
+
+static
+void initLoader(void)
+{
+	wplLoader.initialized = 1;
+	wplLoader.lock = SDL_CreateMutex();
+	wplLoader.jobCount = SDL_CreateSemaphore(0);
+	if(!wplLoader.lock || !wplLoader.jobCount) return;
+
+	i32 count = SDL_GetCPUCount() - 1;
+	if(count > WPL_LOADERS) count = WPL_LOADERS;
+	if(count < 1) count = 1;
+	for(i32 i = 0; i < count; ++i) {
+		SDL_Thread* thread = SDL_CreateThread(loaderMain, "wplLoader", NULL);
+		if(thread) {
+			SDL_DetachThread(thread);
+		}
+	}
+}
+
+/* Like wplLoadTexture, but the decode happens on a loader thread, and a
+ * file that can't be loaded ends up Texture_Failed rather than NULL */
+wplTexture* wplLoadTextureAsync(wplWindow* window, string filename, MemoryArena* arena)
+{
+	if(!wplLoader.initialized) {
+		initLoader();
+	}
+
+	wplTexture* texture = arenaPush(arena, sizeof(wplTexture));
+	memset(texture, 0, sizeof(wplTexture));
+	texture->status = Texture_Decoding;
+
+	char path[1024];
+	snprintf(path, 1024, "%s%s", window->basePath, filename);
+
+	i32 queued = 0;
+	if(wplLoader.lock && wplLoader.jobCount) {
+		SDL_LockMutex(wplLoader.lock);
+		if(wplLoader.jobHead - wplLoader.jobTail < WPL_LOAD_QUEUE) {
+			wplLoadJob* job = wplLoader.jobs + wplLoader.jobHead % WPL_LOAD_QUEUE;
+			job->texture = texture;
+			memcpy(job->path, path, sizeof(path));
+			wplLoader.jobHead++;
+			queued = 1;
+		}
+		SDL_UnlockMutex(wplLoader.lock);
+	}
+
+	if(queued) {
+		SDL_SemPost(wplLoader.jobCount);
+	} else {
+		loaderDecode(texture, path);
+	}
+	return texture;
+}
+
+/* Queues texture to be uploaded once it's decoded. Textures that are
+ * already in memory (loaded, or an atlas) work too. */
+void wplUploadTextureAsync(wplTexture* texture)
+{
+	if(wplLoader.uploadCount == wplLoader.uploadCapacity) {
+		if(!wplLoader.arena) {
+			wplLoader.arena = arenaBootstrap(getMemoryInfo(), 0);
+			wplLoader.arena->name = "loader";
+		}
+		i64 cap = wplLoader.uploadCapacity ? 
+			wplLoader.uploadCapacity * 2 : WPL_LOAD_QUEUE;
+		wplTexture** uploads = arenaPush(wplLoader.arena, sizeof(wplTexture*) * cap);
+		if(wplLoader.uploadCount) {
+			memcpy(uploads, wplLoader.uploads, 
+					sizeof(wplTexture*) * wplLoader.uploadCount);
+		}
+		wplLoader.uploads = uploads;
+		wplLoader.uploadCapacity = cap;
+	}
+	if(texture->status == Texture_Ready) {
+		texture->status = Texture_Decoded;
+	}
+	wplLoader.uploads[wplLoader.uploadCount++] = texture;
+}
+
+/* Returns 1 once every texture has decoded (or failed) */
+i32 wplTexturesDecoded(wplTexture** textures, i64 count)
+{
+	for(i64 i = 0; i < count; ++i) {
+		if(textures[i]->status == Texture_Decoding) return 0;
+	}
+	SDL_MemoryBarrierAcquire();
+	return 1;
+}
+
+i32 wplTextureReady(wplTexture* texture)
+{
+	if(texture->atlas) {
+		texture = texture->atlas;
+	}
+	return texture->status == Texture_Ready;
+}
+
+static
+void uploadStart(wplWindow* window, wplTexture* texture)
+{
+	texture->status = Texture_Uploading;
+	texture->uploadedRows = 0;
+	if(window->soft) return;
+
+	glGenTextures(1, &texture->glIndex);
+	glBindTexture(GL_TEXTURE_2D, texture->glIndex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+			texture->w, texture->h, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE,
+			NULL);
+
+	// Without glMapBufferRange the rows just go straight from pixels
+	if(window->glVersion > 21) {
+		glGenBuffers(1, &texture->uploadBuffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->uploadBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER,
+				texture->w * texture->h * 4, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+}
+
+/* Sends up to rows more rows; returns 1 when the texture is complete */
+static
+i32 uploadRows(wplWindow* window, wplTexture* texture, i64 rows)
+{
+	i64 start = texture->uploadedRows;
+	if(start + rows > texture->h) rows = texture->h - start;
+	texture->uploadedRows += rows;
+	if(window->soft) {
+		return texture->uploadedRows == texture->h;
+	}
+
+	isize pitch = texture->w * 4;
+	u8* src = texture->pixels + start * pitch;
+	glBindTexture(GL_TEXTURE_2D, texture->glIndex);
+	if(texture->uploadBuffer) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->uploadBuffer);
+		void* dest = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+				start * pitch, rows * pitch,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+				GL_MAP_UNSYNCHRONIZED_BIT);
+		if(dest) {
+			memcpy(dest, src, rows * pitch);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			src = (u8*)(start * pitch);
+		} else {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+	}
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, start, texture->w, rows,
+			GL_RGBA, GL_UNSIGNED_BYTE, src);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if(texture->uploadedRows < texture->h) {
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return 0;
+	}
+
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	if(texture->uploadBuffer) {
+		glDeleteBuffers(1, &texture->uploadBuffer);
+		texture->uploadBuffer = 0;
+	}
+	return 1;
+}
+
+/* Called from wplUpdate. Works through the upload queue in order until
+ * the frame's budget is spent; a texture bigger than the budget goes up
+ * over several frames. */
+static
+void loaderPump(wplWindow* window)
+{
+	i64 budget = WPL_UPLOAD_BUDGET;
+	i64 kept = 0;
+	for(i64 i = 0; i < wplLoader.uploadCount; ++i) {
+		wplTexture* texture = wplLoader.uploads[i];
+		i32 status = texture->status;
+		if(status == Texture_Failed) continue;
+		if(status == Texture_Decoding || (budget <= 0 && !window->soft)) {
+			wplLoader.uploads[kept++] = texture;
+			continue;
+		}
+
+		SDL_MemoryBarrierAcquire();
+		// The software renderer reads pixels as they are, so there's no
+		// reason to spread them over frames; headless runs stay repeatable
+		if(window->soft) {
+			texture->status = Texture_Ready;
+			continue;
+		}
+		if(status == Texture_Decoded) {
+			uploadStart(window, texture);
+		}
+		i64 pitch = texture->w * 4;
+		i64 rows = pitch > 0 ? budget / pitch : texture->h;
+		// Always make some progress, however wide the texture
+		if(rows < 1) rows = 1;
+		if(rows > texture->h - texture->uploadedRows) {
+			rows = texture->h - texture->uploadedRows;
+		}
+		budget -= rows * pitch;
+		if(uploadRows(window, texture, rows)) {
+			texture->status = Texture_Ready;
+		} else {
+			wplLoader.uploads[kept++] = texture;
+		}
+	}
+	wplLoader.uploadCount = kept;
+}
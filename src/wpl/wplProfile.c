@@ -0,0 +1,220 @@
+/* Frame timing. CPU times come from the performance counter around
+ * wplUpdate and wplRender, and whatever the game does between the two
+ * counts as its update. Each draw gets a GL_TIME_ELAPSED query; those
+ * are read back WPL_PROFILE_LATENCY frames later, when the GPU is long
+ * done with them, so profiling never waits on the driver. Without timer
+ * queries (or headless) draws are timed on the CPU instead. */
+
+typedef struct wplProfileFrame wplProfileFrame;
+struct wplProfileFrame
+{
+	u32 queries[WPL_PROFILE_DRAWS];
+	wplDrawTiming draws[WPL_PROFILE_DRAWS];
+	i32 count;
+};
+
+struct wplProfiler
+{
+	wplProfile stats;
+	wplProfileFrame frames[WPL_PROFILE_LATENCY];
+	i64 frame;
+	i32 hasQueries;
+
+	// Draws nest when the batch goes through wplGroupDraw; only the
+	// outermost one is timed, since GL can't nest elapsed queries
+	i32 depth;
+	u64 drawStart;
+	u64 frameStart, updateEnd, renderStart;
+	f64 msPerTick;
+};
+
+static struct wplProfiler wplProfiler;
+
+static
+f32 profileMs(u64 start, u64 end)
+{
+	return (f32)((f64)(end - start) * wplProfiler.msPerTick);
+}
+
+void wplProfileEnable(wplWindow* window, i32 enabled)
+{
+	struct wplProfiler* p = &wplProfiler;
+	if(enabled && !p->msPerTick) {
+		p->msPerTick = 1000.0 / (f64)SDL_GetPerformanceFrequency();
+		if(window->glVersion >= 33) {
+			for(isize i = 0; i < WPL_PROFILE_LATENCY; ++i) {
+				glGenQueries(WPL_PROFILE_DRAWS, p->frames[i].queries);
+			}
+			p->hasQueries = 1;
+		}
+	}
+	if(enabled && !p->stats.enabled) {
+		// Whatever was queued before it was switched off is stale
+		for(isize i = 0; i < WPL_PROFILE_LATENCY; ++i) {
+			p->frames[i].count = 0;
+		}
+		p->frameStart = 0;
+		p->depth = 0;
+	}
+	p->stats.enabled = enabled;
+}
+
+wplProfile* wplGetProfile(void)
+{
+	return &wplProfiler.stats;
+}
+
+f64 wplGetTimeMs(void)
+{
+	return (f64)SDL_GetPerformanceCounter() * 1000.0 / 
+		(f64)SDL_GetPerformanceFrequency();
+}
+
+/* Collects the frame that used this slot last time around, then hands
+ * the slot to the frame that's starting */
+static
+void profileFrameStart(void)
+{
+	struct wplProfiler* p = &wplProfiler;
+	if(!p->stats.enabled) return;
+	u64 now = SDL_GetPerformanceCounter();
+	if(p->frameStart) {
+		p->stats.frameMs = profileMs(p->frameStart, now);
+	}
+	p->frameStart = now;
+
+	wplProfileFrame* frame = p->frames + p->frame % WPL_PROFILE_LATENCY;
+	i32 ready = frame->count > 0;
+	if(ready && p->hasQueries) {
+		i32 available = 0;
+		glGetQueryObjectiv(frame->queries[frame->count - 1],
+				GL_QUERY_RESULT_AVAILABLE, &available);
+		// Queries finish in order, so the last one being done means
+		// they all are. If it isn't, the frame is just dropped
+		ready = available;
+		for(isize i = 0; ready && i < frame->count; ++i) {
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(frame->queries[i], GL_QUERY_RESULT, &ns);
+			frame->draws[i].gpuMs = (f32)ns / 1000000.0f;
+		}
+	}
+
+	if(ready) {
+		wplProfile* stats = &p->stats;
+		stats->gpuMs = 0;
+		stats->drawCount = frame->count;
+		for(isize i = 0; i < frame->count; ++i) {
+			stats->draws[i] = frame->draws[i];
+			stats->gpuMs += frame->draws[i].gpuMs;
+		}
+	}
+	frame->count = 0;
+}
+
+static
+void profileUpdateEnd(void)
+{
+	if(!wplProfiler.stats.enabled) return;
+	u64 now = SDL_GetPerformanceCounter();
+	wplProfiler.stats.platformMs = profileMs(wplProfiler.frameStart, now);
+	wplProfiler.updateEnd = now;
+}
+
+static
+void profileRenderStart(void)
+{
+	if(!wplProfiler.stats.enabled) return;
+	u64 now = SDL_GetPerformanceCounter();
+	wplProfiler.stats.gameMs = profileMs(wplProfiler.updateEnd, now);
+	wplProfiler.renderStart = now;
+}
+
+static
+void profileRenderEnd(void)
+{
+	struct wplProfiler* p = &wplProfiler;
+	if(!p->stats.enabled) return;
+	wplProfile* stats = &p->stats;
+	stats->renderMs = profileMs(p->renderStart, SDL_GetPerformanceCounter());
+
+	stats->history[stats->historyHead] = stats->frameMs;
+	stats->gpuHistory[stats->historyHead] = stats->gpuMs;
+	stats->historyHead = (stats->historyHead + 1) % WPL_PROFILE_HISTORY;
+	p->frame++;
+}
+
+static
+void profileDrawBegin(i32 layer, i64 sprites)
+{
+	struct wplProfiler* p = &wplProfiler;
+	if(!p->stats.enabled) return;
+	if(p->depth++ > 0) return;
+	wplProfileFrame* frame = p->frames + p->frame % WPL_PROFILE_LATENCY;
+	if(frame->count >= WPL_PROFILE_DRAWS) return;
+
+	wplDrawTiming* draw = frame->draws + frame->count;
+	draw->layer = layer;
+	draw->sprites = sprites;
+	draw->gpuMs = 0;
+	if(p->hasQueries) {
+		glBeginQuery(GL_TIME_ELAPSED, frame->queries[frame->count]);
+	} else {
+		p->drawStart = SDL_GetPerformanceCounter();
+	}
+}
+
+static
+void profileDrawEnd(void)
+{
+	struct wplProfiler* p = &wplProfiler;
+	if(!p->stats.enabled) return;
+	if(--p->depth > 0) return;
+	wplProfileFrame* frame = p->frames + p->frame % WPL_PROFILE_LATENCY;
+	if(frame->count >= WPL_PROFILE_DRAWS) return;
+
+	if(p->hasQueries) {
+		glEndQuery(GL_TIME_ELAPSED);
+	} else {
+		frame->draws[frame->count].gpuMs = profileMs(p->drawStart,
+				SDL_GetPerformanceCounter());
+	}
+	frame->count++;
+}
+
+/* Startup timeline. Marks are cheap and always recorded; 
+ * wplStartupPrint shows each one's time since the first. */
+#define WPL_STARTUP_MARKS 32
+
+struct wplStartupTimeline
+{
+	string labels[WPL_STARTUP_MARKS];
+	u64 times[WPL_STARTUP_MARKS];
+	i32 count;
+};
+
+static struct wplStartupTimeline wplStartup;
+
+void wplStartupMark(string label)
+{
+	if(wplStartup.count == WPL_STARTUP_MARKS) return;
+	wplStartup.labels[wplStartup.count] = label;
+	wplStartup.times[wplStartup.count] = SDL_GetPerformanceCounter();
+	wplStartup.count++;
+}
+
+void wplStartupPrint(void)
+{
+	if(wplStartup.count == 0) return;
+	f64 msPerTick = 1000.0 / (f64)SDL_GetPerformanceFrequency();
+	u64 start = wplStartup.times[0];
+	u64 last = start;
+	printf("Startup:\n");
+	for(i32 i = 0; i < wplStartup.count; ++i) {
+		u64 t = wplStartup.times[i];
+		printf("  %8.2fms (+%7.2fms) %s\n",
+				(f64)(t - start) * msPerTick,
+				(f64)(t - last) * msPerTick,
+				wplStartup.labels[i]);
+		last = t;
+	}
+}
@@ -1,6 +1,204 @@
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+/* wb_gl only loads up to 3.3, so glBufferStorage gets loaded by hand */
+typedef void wplBufferStorageProc(GLenum target, GLsizeiptr size, 
+		const void* data, GLbitfield flags);
+static wplBufferStorageProc* wplglBufferStorage;
+static i32 wplBufferStorageChecked;
+
+// Set by wplCreateWindow for headless windows, which have no GL
+static i32 wplHeadless;
+
+static
+wplBufferStorageProc* getBufferStorage(wplWindow* window)
+{
+	if(!wplBufferStorageChecked) {
+		wplBufferStorageChecked = 1;
+		if(window->glVersion >= 33 && 
+				SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) {
+			wplglBufferStorage = (wplBufferStorageProc*)
+				SDL_GL_GetProcAddress("glBufferStorage");
+		}
+	}
+	return wplglBufferStorage;
+}
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+/* Program binaries (GL 4.1 or ARB_get_program_binary) are loaded by hand
+ * too. Linked programs are cached in basePath, keyed by a hash of the 
+ * driver strings and shader source, so a driver update or shader edit 
+ * just misses the cache. */
+typedef void wplGetProgramBinaryProc(GLuint program, GLsizei bufSize, 
+		GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void wplProgramBinaryProc(GLuint program, GLenum binaryFormat, 
+		const void* binary, GLsizei length);
+typedef void wplProgramParameteriProc(GLuint program, GLenum pname, GLint value);
+static wplGetProgramBinaryProc* wplglGetProgramBinary;
+static wplProgramBinaryProc* wplglProgramBinary;
+static wplProgramParameteriProc* wplglProgramParameteri;
+static i32 wplProgramBinaryChecked;
+
+typedef struct wplProgramCacheHeader wplProgramCacheHeader;
+struct wplProgramCacheHeader
+{
+	u64 key;
+	u32 format;
+	i32 length;
+};
+
+static
+i32 hasProgramBinary(wplWindow* window)
+{
+	if(!wplProgramBinaryChecked) {
+		wplProgramBinaryChecked = 1;
+		i32 formats = 0;
+		if(window->glVersion >= 33 && 
+				SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) {
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		}
+		if(formats > 0) {
+			wplglGetProgramBinary = (wplGetProgramBinaryProc*)
+				SDL_GL_GetProcAddress("glGetProgramBinary");
+			wplglProgramBinary = (wplProgramBinaryProc*)
+				SDL_GL_GetProcAddress("glProgramBinary");
+			wplglProgramParameteri = (wplProgramParameteriProc*)
+				SDL_GL_GetProcAddress("glProgramParameteri");
+		}
+	}
+	return wplglGetProgramBinary && wplglProgramBinary && wplglProgramParameteri;
+}
+
+static
+u64 programCacheKey(wplWindow* window)
+{
+	const char* parts[5] = {
+		(const char*)glGetString(GL_VENDOR),
+		(const char*)glGetString(GL_RENDERER),
+		(const char*)glGetString(GL_VERSION),
+		(const char*)window->vertShader,
+		(const char*)window->fragShader
+	};
+
+	// FNV-1a, with a separator so the parts can't run together
+	u64 hash = 14695981039346656037ULL;
+	for(isize i = 0; i < 5; ++i) {
+		const char* c = parts[i] ? parts[i] : "";
+		for(; *c; ++c) {
+			hash = (hash ^ (u8)*c) * 1099511628211ULL;
+		}
+		hash = (hash ^ 0xFF) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+static
+void programCachePath(wplWindow* window, u64 key, char* path, isize size)
+{
+	snprintf(path, size, "%sshader_%016llx.cache", 
+			window->basePath, (unsigned long long)key);
+}
+
+static
+i32 loadCachedProgram(wplWindow* window, wplShader* shader, u64 key)
+{
+	char path[1024];
+	programCachePath(window, key, path, 1024);
+	FILE* f = fopen(path, "rb");
+	if(!f) return 0;
+
+	MemoryArena* scratch = arenaThreadScratch();
+	ArenaCheckpoint cp = arenaCheckpoint(scratch);
+	wplProgramCacheHeader header;
+	void* binary = NULL;
+	if(fread(&header, sizeof(header), 1, f) == 1 && 
+			header.key == key && header.length > 0) {
+		binary = arenaPush(scratch, header.length);
+		if(fread(binary, header.length, 1, f) != 1) {
+			binary = NULL;
+		}
+	}
+	fclose(f);
+
+	i32 success = 0;
+	if(binary) {
+		u32 program = glCreateProgram();
+		wplglProgramBinary(program, header.format, binary, header.length);
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if(success) {
+			shader->program = program;
+		} else {
+			glDeleteProgram(program);
+		}
+	}
+	arenaRewind(cp);
+	return success;
+}
+
+static
+void saveCachedProgram(wplWindow* window, wplShader* shader, u64 key)
+{
+	i32 length = 0;
+	glGetProgramiv(shader->program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0) return;
+
+	MemoryArena* scratch = arenaThreadScratch();
+	ArenaCheckpoint cp = arenaCheckpoint(scratch);
+	wplProgramCacheHeader header;
+	header.key = key;
+	header.length = 0;
+	void* binary = arenaPush(scratch, length);
+	wplglGetProgramBinary(shader->program, length, 
+			&header.length, &header.format, binary);
+
+	char path[1024];
+	programCachePath(window, key, path, 1024);
+	FILE* f = header.length > 0 ? fopen(path, "wb") : NULL;
+	if(f) {
+		fwrite(&header, sizeof(header), 1, f);
+		fwrite(binary, header.length, 1, f);
+		fclose(f);
+	}
+	arenaRewind(cp);
+}
+
+static
+void getShaderUniforms(wplShader* shader)
+{
+	shader->uOrtho = glGetUniformLocation(shader->program, "uOrtho");
+	shader->uTint = glGetUniformLocation(shader->program, "uTint");
+	shader->uShadow = glGetUniformLocation(shader->program, "uShadow");
+	shader->uInvTextureSize = glGetUniformLocation(shader->program, "uInvTextureSize");
+	shader->uScale = glGetUniformLocation(shader->program, "uScale");
+	shader->uOffset = glGetUniformLocation(shader->program, "uOffset");
+	shader->uViewport = glGetUniformLocation(shader->program, "uViewport");
+	shader->uTextureOffset = glGetUniformLocation(shader->program, "uTextureOffset");
+	shader->uUnpack = glGetUniformLocation(shader->program, "uUnpack");
+	shader->uGlyphs = glGetUniformLocation(shader->program, "uGlyphs");
+	shader->uGlyphMode = glGetUniformLocation(shader->program, "uGlyphMode");
+}
+
 static
 void initDefaultShader(wplWindow* window, wplShader* shader)
 {
+	u64 cacheKey = 0;
+	if(window->glVersion >= 33 && hasProgramBinary(window)) {
+		cacheKey = programCacheKey(window);
+		if(loadCachedProgram(window, shader, cacheKey)) {
+			glUseProgram(shader->program);
+			getShaderUniforms(shader);
+			wplStartupMark("shader (cached)");
+			return;
+		}
+	}
+
 	u32 vert = glCreateShader(GL_VERTEX_SHADER);
 	glShaderSource(vert, 1, &window->vertShader, NULL);
 	glCompileShader(vert);
@@ -64,6 +262,10 @@ void initDefaultShader(wplWindow* window, wplShader* shader)
 
 	glAttachShader(shader->program, vert);
 	glAttachShader(shader->program, frag);
+	if(cacheKey) {
+		wplglProgramParameteri(shader->program, 
+				GL_PROGRAM_BINARY_RETRIEVABLE_HINT, 1);
+	}
 	glLinkProgram(shader->program);
 
 	{
@@ -80,13 +282,321 @@ void initDefaultShader(wplWindow* window, wplShader* shader)
 
 	//TODO(will) Do shader program error checking
 	glUseProgram(shader->program);
-	shader->uOrtho = glGetUniformLocation(shader->program, "uOrtho");
-	shader->uTint = glGetUniformLocation(shader->program, "uTint");
-	shader->uShadow = glGetUniformLocation(shader->program, "uShadow");
-	shader->uInvTextureSize = glGetUniformLocation(shader->program, "uInvTextureSize");
-	shader->uScale = glGetUniformLocation(shader->program, "uScale");
-	shader->uOffset = glGetUniformLocation(shader->program, "uOffset");
-	shader->uViewport = glGetUniformLocation(shader->program, "uViewport");
+	getShaderUniforms(shader);
+	if(cacheKey) {
+		saveCachedProgram(window, shader, cacheKey);
+	}
+	wplStartupMark("shader (compiled)");
+}
+
+/* Points the instance attributes at the sprites starting at offset bytes
+ * into the group's vbo */
+static
+void groupSpriteAttribs(isize offset)
+{
+	i32 i = 0;
+	i32 stride = sizeof(wplSprite);
+#define spriteMember(name) (void*)(offset + offsetof(wplSprite, name))
+	glVertexAttribIPointer(i++, 1, GL_INT, stride, spriteMember(flags));
+	glVertexAttribPointer(i++, 4, GL_UNSIGNED_BYTE, 1, stride, spriteMember(color));
+	glVertexAttribPointer(i++, 2, GL_FLOAT, 0, stride, spriteMember(x));
+	glVertexAttribPointer(i++, 2, GL_FLOAT, 0, stride, spriteMember(w));
+	glVertexAttribPointer(i++, 2, GL_FLOAT, 0, stride, spriteMember(cx));
+	glVertexAttribPointer(i++, 4, GL_SHORT, 0, stride, spriteMember(tx));
+	glVertexAttribPointer(i++, 1, GL_FLOAT, 0, stride, spriteMember(angle));
+#undef spriteMember
+	for(i32 j = 4; j < 7; ++j) {
+		glEnableVertexAttribArray(j);
+	}
+}
+
+/* The same for wplPackedSprites. They have no center, so that attribute 
+ * is switched off and left at zero */
+static
+void groupPackedAttribs(isize offset)
+{
+	i32 i = 0;
+	i32 stride = sizeof(wplPackedSprite);
+#define packedMember(name) (void*)(offset + offsetof(wplPackedSprite, name))
+	glVertexAttribIPointer(i++, 1, GL_UNSIGNED_SHORT, stride, packedMember(flags));
+	glVertexAttribPointer(i++, 4, GL_UNSIGNED_BYTE, 1, stride, packedMember(color));
+	glVertexAttribPointer(i++, 2, GL_SHORT, 0, stride, packedMember(x));
+	glVertexAttribPointer(i++, 2, GL_UNSIGNED_SHORT, 0, stride, packedMember(w));
+	i++;
+	glVertexAttribPointer(i++, 4, GL_SHORT, 0, stride, packedMember(tx));
+	glVertexAttribPointer(i++, 1, GL_UNSIGNED_SHORT, 0, stride, packedMember(angle));
+#undef packedMember
+	glDisableVertexAttribArray(4);
+	glVertexAttrib2f(4, 0, 0);
+	glEnableVertexAttribArray(5);
+	glEnableVertexAttribArray(6);
+}
+
+/* And for wplGlyphSprites, whose size attribute is (glyph, scale) */
+static
+void groupGlyphAttribs(isize offset)
+{
+	i32 stride = sizeof(wplGlyphSprite);
+#define glyphMember(name) (void*)(offset + offsetof(wplGlyphSprite, name))
+	glVertexAttribIPointer(0, 1, GL_UNSIGNED_SHORT, stride, glyphMember(flags));
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, 1, stride, glyphMember(color));
+	glVertexAttribPointer(2, 2, GL_SHORT, 0, stride, glyphMember(x));
+	glVertexAttribPointer(3, 2, GL_UNSIGNED_BYTE, 0, stride, glyphMember(glyph));
+#undef glyphMember
+	for(i32 i = 4; i < 7; ++i) {
+		glDisableVertexAttribArray(i);
+	}
+	glVertexAttrib2f(4, 0, 0);
+	glVertexAttrib1f(6, 0);
+}
+
+static
+void setUnpackUniform(wplShader* shader, i32 format)
+{
+	if(format != Instance_Sprite) {
+		glUniform2f(shader->uUnpack, 
+				1.0f / WPL_PACKED_UNIT, 
+				6.2831853f / 65536.0f);
+	} else {
+		glUniform2f(shader->uUnpack, 1, 1);
+	}
+	glUniform1i(shader->uGlyphMode, format == Instance_Glyph);
+}
+
+/* Packs count sprites, or returns 0 at the first one that won't fit */
+static
+i32 packSprites(wplSprite* src, wplPackedSprite* dest, isize count)
+{
+	const f32 turn = 65536.0f / 6.2831853f;
+	for(isize i = 0; i < count; ++i) {
+		wplSprite* s = src + i;
+		wplPackedSprite* p = dest + i;
+		if(s->angle != 0 && (s->cx != 0 || s->cy != 0)) return 0;
+		if(s->flags & ~0xFFFF) return 0;
+
+		f32 x = s->x * WPL_PACKED_UNIT, y = s->y * WPL_PACKED_UNIT;
+		f32 w = s->w * WPL_PACKED_UNIT, h = s->h * WPL_PACKED_UNIT;
+		if(!(x >= -32768 && x <= 32767 && y >= -32768 && y <= 32767 &&
+				w >= 0 && w <= 65535 && h >= 0 && h <= 65535)) {
+			return 0;
+		}
+		if(x != (f32)(i32)x || y != (f32)(i32)y || 
+				w != (f32)(i32)w || h != (f32)(i32)h) {
+			return 0;
+		}
+
+		p->x = (i16)x;
+		p->y = (i16)y;
+		p->w = (u16)w;
+		p->h = (u16)h;
+		p->tx = s->tx;
+		p->ty = s->ty;
+		p->tw = s->tw;
+		p->th = s->th;
+		p->color = s->color;
+		p->flags = (u16)s->flags;
+		// Wraps, which is what we want for negative angles
+		p->angle = (u16)(i32)floorf(s->angle * turn + 0.5f);
+	}
+	return 1;
+}
+
+static
+u32 glyphSlot(i32 tx, i32 ty)
+{
+	return (u32)(tx * 7 + ty * 131) & 255;
+}
+
+/* rects are x, y, w, h in the group's texture, as the font has them */
+wplGlyphTable* wplCreateGlyphTable(i16* rects, i32 count, MemoryArena* arena)
+{
+	wplGlyphTable* table = arenaPush(arena, sizeof(wplGlyphTable));
+	memset(table, 0, sizeof(wplGlyphTable));
+	if(count > WPL_MAX_GLYPHS) count = WPL_MAX_GLYPHS;
+	table->count = count;
+	for(i32 i = 0; i < count; ++i) {
+		i16* r = rects + i * 4;
+		for(i32 j = 0; j < 4; ++j) {
+			table->rects[i][j] = r[j];
+		}
+		// Repeated rects just find the first
+		u32 slot = glyphSlot(r[0], r[1]);
+		while(table->lookup[slot]) {
+			slot = (slot + 1) & 255;
+		}
+		table->lookup[slot] = (u8)(i + 1);
+	}
+	return table;
+}
+
+/* Packs s as a glyph if it's exactly one of the table's rects (less the 
+ * atlas offset), unrotated, at a scale that's a whole number of 
+ * 1/WPL_GLYPH_SCALE steps; returns 0 if it isn't */
+static
+i32 packGlyph(wplGlyphTable* table, wplSprite* s, i32 offsetX, i32 offsetY, 
+		wplGlyphSprite* p)
+{
+	if(s->angle != 0 || (s->flags & ~0xFFFF) || s->tw <= 0) return 0;
+	i32 tx = s->tx - offsetX, ty = s->ty - offsetY;
+	u32 slot = glyphSlot(tx, ty);
+	i32 glyph = -1;
+	while(table->lookup[slot]) {
+		i32 index = table->lookup[slot] - 1;
+		if(table->rects[index][0] == tx && table->rects[index][1] == ty) {
+			glyph = index;
+			break;
+		}
+		slot = (slot + 1) & 255;
+	}
+	if(glyph < 0) return 0;
+	if(table->rects[glyph][2] != s->tw || table->rects[glyph][3] != s->th) return 0;
+
+	f32 scale = s->w * WPL_GLYPH_SCALE / s->tw;
+	if(!(scale >= 1 && scale <= 255) || scale != (f32)(i32)scale) return 0;
+	if(s->h != (f32)(s->th * (i32)scale) / WPL_GLYPH_SCALE) return 0;
+
+	f32 x = s->x * WPL_PACKED_UNIT, y = s->y * WPL_PACKED_UNIT;
+	if(!(x >= -32768 && x <= 32767 && y >= -32768 && y <= 32767)) return 0;
+	if(x != (f32)(i32)x || y != (f32)(i32)y) return 0;
+
+	p->x = (i16)x;
+	p->y = (i16)y;
+	p->glyph = (u8)glyph;
+	p->scale = (u8)scale;
+	p->flags = (u16)s->flags;
+	p->color = s->color;
+	return 1;
+}
+
+static
+void groupInitRing(wplWindow* window, wplRenderGroup* group)
+{
+	wplBufferStorageProc* bufferStorage = getBufferStorage(window);
+	if(!bufferStorage) return;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | 
+		GL_MAP_PERSISTENT_BIT | 
+		GL_MAP_COHERENT_BIT;
+	group->ringSegmentSize = group->capacity * WPL_RING_DRAWS;
+	isize size = sizeof(wplSprite) * 
+		group->ringSegmentSize * WPL_RING_SEGMENTS;
+	bufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+	group->ring = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+	if(!group->ring) {
+		// Storage is immutable now, so start over with a fresh buffer
+		glDeleteBuffers(1, &group->vbo);
+		glGenBuffers(1, &group->vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, group->vbo);
+		groupSpriteAttribs(0);
+		return;
+	}
+
+	memset(group->ring, 0, size);
+	for(isize i = 0; i < WPL_RING_SEGMENTS; ++i) {
+		group->ringFences[i] = NULL;
+	}
+	group->ringSegment = 0;
+	group->ringHead = 0;
+	group->sprites = group->ring;
+}
+
+/* Replaces the ring with one sized for the group's current capacity.
+ * The sprites are left where they are, and get copied in at the draw */
+static
+void groupResizeRing(wplWindow* window, wplRenderGroup* group)
+{
+	for(isize i = 0; i < WPL_RING_SEGMENTS; ++i) {
+		if(group->ringFences[i]) {
+			glDeleteSync(group->ringFences[i]);
+		}
+	}
+	glDeleteBuffers(1, &group->vbo);
+	glGenBuffers(1, &group->vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, group->vbo);
+	group->ring = NULL;
+	wplSprite* sprites = group->sprites;
+	groupInitRing(window, group);
+	group->sprites = sprites;
+}
+
+/* Retires the count sprites just drawn from the ring. Once there isn't 
+ * room left in the segment for another full draw, we fence it and move on
+ * to the next one, waiting for the GPU if it's still reading it. */
+static
+void groupRingAdvance(wplRenderGroup* group)
+{
+	group->ringHead += group->count;
+	if(group->ringHead + group->capacity > group->ringSegmentSize) {
+		group->ringFences[group->ringSegment] = 
+			glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		group->ringSegment = (group->ringSegment + 1) % WPL_RING_SEGMENTS;
+		group->ringHead = 0;
+
+		GLsync fence = group->ringFences[group->ringSegment];
+		if(fence) {
+			while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 
+						1000000) == GL_TIMEOUT_EXPIRED);
+			glDeleteSync(fence);
+			group->ringFences[group->ringSegment] = NULL;
+		}
+	}
+}
+
+static
+wplSprite* groupRingHead(wplRenderGroup* group)
+{
+	return group->ring + 
+		group->ringSegment * group->ringSegmentSize + 
+		group->ringHead;
+}
+
+static inline
+void groupMarkDirty(wplRenderGroup* group, i64 start, i64 end)
+{
+	if(group->dirtyStart >= group->dirtyEnd) {
+		group->dirtyStart = start;
+		group->dirtyEnd = end;
+	} else {
+		if(start < group->dirtyStart) group->dirtyStart = start;
+		if(end > group->dirtyEnd) group->dirtyEnd = end;
+	}
+}
+
+/* Pulls the group's sprites out of the ring so they can be kept and
+ * edited between draws */
+static
+void groupMoveToLocal(wplRenderGroup* group)
+{
+	if(group->sprites == group->localSprites) return;
+	memcpy(group->localSprites, group->sprites, 
+			sizeof(wplSprite) * group->count);
+	group->sprites = group->localSprites;
+}
+
+/* Doubles the group's arrays out of its arena. The old ones are left 
+ * behind, so a group grows a handful of times until it fits its peak, and
+ * the GPU side buffers are resized the next time it's drawn */
+static
+void groupGrow(wplRenderGroup* group)
+{
+	i64 cap = group->capacity * 2;
+	wplSprite* sprites = arenaPush(group->arena, sizeof(wplSprite) * cap);
+	memcpy(sprites, group->sprites, sizeof(wplSprite) * group->count);
+	group->localSprites = sprites;
+	group->sprites = sprites;
+	group->verts = arenaPush(group->arena, sizeof(wplVertex) * 4 * cap);
+	group->indices = arenaPush(group->arena, sizeof(i32) * cap);
+	group->vertCounts = arenaPush(group->arena, sizeof(i32) * cap);
+	if(group->glyphSprites) {
+		wplGlyphSprite* glyphs = arenaPush(group->arena, sizeof(wplGlyphSprite) * cap);
+		memcpy(glyphs, group->glyphSprites, sizeof(wplGlyphSprite) * group->count);
+		group->glyphSprites = glyphs;
+	}
+	group->capacity = cap;
+	group->grows++;
+	if(!group->clearOnDraw) {
+		groupMarkDirty(group, 0, group->count);
+	}
 }
 
 wplSprite* wplGroupAdd(
@@ -110,15 +620,116 @@ wplSprite* wplGroupAdd(
 	s.tw = tw;
 	s.th = th;
 	s.angle = 0;
+	if(group->count >= group->capacity) {
+		groupGrow(group);
+	}
+	if(!group->clearOnDraw) {
+		groupMarkDirty(group, group->count, group->count + 1);
+	}
 	group->sprites[group->count++] = s;
 	return group->sprites + group->count - 1;
 }
 
 wplSprite* wplGetSprite(wplRenderGroup* group)
 {
+	if(group->count >= group->capacity) {
+		groupGrow(group);
+	}
+	if(!group->clearOnDraw) {
+		groupMarkDirty(group, group->count, group->count + 1);
+	}
 	return group->sprites + group->count++;
 }
 
+/* Reserves count sprites at the end of the group, for runs that were 
+ * built somewhere else and just need copying in. They're uninitialized,
+ * and may be write-combined memory, so write them without reading back */
+wplSprite* wplGroupAddSprites(wplRenderGroup* group, i64 count)
+{
+	while(group->count + count > group->capacity) {
+		groupGrow(group);
+	}
+	if(!group->clearOnDraw) {
+		groupMarkDirty(group, group->count, group->count + count);
+	}
+	wplSprite* sprites = group->sprites + group->count;
+	group->count += count;
+	return sprites;
+}
+
+/* Gives the last count sprites added their glyph instances, offset by
+ * x, y in 1/WPL_PACKED_UNIT steps, so the batch copies them instead of 
+ * matching each sprite against the glyph table. They have to be the same
+ * glyphs the sprites are; the sprites are still what the software and 
+ * basic paths draw. Retained groups just keep the sprites. */
+void wplGroupAttachGlyphs(wplRenderGroup* group, wplGlyphSprite* glyphs, 
+		i64 count, i32 x, i32 y)
+{
+	if(!group->clearOnDraw || !group->glyphs || count == 0) return;
+	if(!group->glyphSprites) {
+		group->glyphSprites = arenaPush(group->arena, 
+				sizeof(wplGlyphSprite) * group->capacity);
+	}
+	i64 start = group->count - count;
+	wplGlyphSprite* out = group->glyphSprites + start;
+	for(i64 i = 0; i < count; ++i) {
+		wplGlyphSprite g = glyphs[i];
+		g.x += x;
+		g.y += y;
+		out[i] = g;
+	}
+
+	// Text drawn back to back makes one span
+	if(group->glyphSpanCount > 0) {
+		wplGlyphSpan* last = group->glyphSpans + group->glyphSpanCount - 1;
+		if(last->start + last->count == start) {
+			last->count += count;
+			return;
+		}
+	}
+	if(group->glyphSpanCount == group->glyphSpanCapacity) {
+		i64 cap = group->glyphSpanCapacity ? group->glyphSpanCapacity * 2 : 64;
+		wplGlyphSpan* spans = arenaPush(group->arena, sizeof(wplGlyphSpan) * cap);
+		if(group->glyphSpanCount) {
+			memcpy(spans, group->glyphSpans, 
+					sizeof(wplGlyphSpan) * group->glyphSpanCount);
+		}
+		group->glyphSpans = spans;
+		group->glyphSpanCapacity = cap;
+	}
+	wplGlyphSpan* span = group->glyphSpans + group->glyphSpanCount++;
+	span->start = start;
+	span->count = count;
+}
+
+/* The handle for a sprite in a retained group is its index; editing
+ * through here is what gets the change re-uploaded */
+wplSprite* wplGroupEdit(wplRenderGroup* group, i64 index)
+{
+	groupMarkDirty(group, index, index + 1);
+	return group->sprites + index;
+}
+
+void wplGroupTouch(wplRenderGroup* group, i64 start, i64 end)
+{
+	groupMarkDirty(group, start, end);
+}
+
+void wplGroupClear(wplRenderGroup* group)
+{
+	group->count = 0;
+	group->glyphSpanCount = 0;
+	group->dirtyStart = 0;
+	group->dirtyEnd = 0;
+}
+
+void wplGroupSetRetained(wplRenderGroup* group, i32 retained)
+{
+	groupMoveToLocal(group);
+	group->clearOnDraw = !retained;
+	groupMarkDirty(group, 0, group->count);
+}
+
 void wplGroupInit(
 		wplWindow* window,
 		wplRenderGroup* group, 
@@ -131,25 +742,46 @@ void wplGroupInit(
 	group->offsetX = 0;
 	group->offsetY = 0;
 	group->tint = 0;
+	group->glyphs = NULL;
+	group->glyphSprites = NULL;
+	group->glyphSpans = NULL;
+	group->glyphSpanCount = 0;
+	group->glyphSpanCapacity = 0;
 
 	group->texture = texture;
 	group->shader = shader;
 
-	if(!texture->glIndex) {
+	if(texture && texture->atlas) {
+		texture = texture->atlas;
+	}
+	if(texture && !texture->glIndex && texture->status == Texture_Ready) {
 		wplUploadTexture(texture);
 	}
 
-	if(!shader->vert || !shader->frag || !shader->program) {
+	// Programs from the binary cache have no shader objects
+	if(!window->soft && !shader->program) {
 		initDefaultShader(window, shader);
 	}
 
+	group->arena = arena;
+	group->grows = 0;
 	group->capacity = cap;
-	group->sprites = arenaPush(arena, sizeof(wplSprite) * group->capacity);
+	group->localSprites = arenaPush(arena, sizeof(wplSprite) * group->capacity);
+	group->sprites = group->localSprites;
+	group->ring = NULL;
 	group->verts = arenaPush(arena, sizeof(wplVertex) * 4 * group->capacity);
 	group->indices = arenaPush(arena, sizeof(i32) * group->capacity);
 	group->vertCounts = arenaPush(arena, sizeof(i32) * group->capacity);
 	group->count = 0;
 	group->lastFilled = 0;
+	group->retainedVbo = 0;
+	group->dirtyStart = 0;
+	group->dirtyEnd = 0;
+	group->builtWidth = 0;
+	group->builtHeight = 0;
+	group->vao = 0;
+	group->vbo = 0;
+	if(window->soft) return;
 
 	if(window->glVersion > 21) {
 		glGenVertexArrays(1, &group->vao);
@@ -176,174 +808,508 @@ void wplGroupInit(
 		glEnableVertexAttribArray(i);
 		i++;
 	} else {
-		i32 i = 0;
-		i32 stride = sizeof(wplSprite);
-#define spriteMember(name) (void*)offsetof(wplSprite, name)
-		glVertexAttribIPointer(i, 1, GL_INT, stride, spriteMember(flags));
-		glEnableVertexAttribArray(i);
-		glVertexAttribDivisor(i++, 1);
+		for(i32 i = 0; i < 7; ++i) {
+			glEnableVertexAttribArray(i);
+			glVertexAttribDivisor(i, 1);
+		}
+		groupSpriteAttribs(0);
+		groupInitRing(window, group);
+		glBindVertexArray(0);
+	}
+}
 
-		glVertexAttribPointer(i, 4, GL_UNSIGNED_BYTE, 1, stride, spriteMember(color));
-		glEnableVertexAttribArray(i);
-		glVertexAttribDivisor(i++, 1);
+// Padded out to 16 so any value in the anchor bits is a safe lookup
+float SoffsetX[16] = {0.0, 0.5, 0.0, -0.5, -0.5, -0.5,  0.0,  0.5, 0.5};
+float SoffsetY[16] = {0.0, 0.5, 0.5,  0.5,  0.0, -0.5, -0.5, -0.5, 0.0};
 
-		glVertexAttribPointer(i, 2, GL_FLOAT, 0, stride, spriteMember(x));
-		glEnableVertexAttribArray(i);
-		glVertexAttribDivisor(i++, 1);
+#ifdef _MSC_VER
+#define WPL_TARGET_AVX2
+#else
+#define WPL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
 
-		glVertexAttribPointer(i, 2, GL_FLOAT, 0, stride, spriteMember(w));
-		glEnableVertexAttribArray(i);
-		glVertexAttribDivisor(i++, 1);
+// Groups smaller than this aren't worth waking the workers for
+#define WPL_PARALLEL_SPRITES 4096
 
-		glVertexAttribPointer(i, 2, GL_FLOAT, 0, stride, spriteMember(cx));
-		glEnableVertexAttribArray(i);
-		glVertexAttribDivisor(i++, 1);
+typedef struct wplGroupTransform wplGroupTransform;
+struct wplGroupTransform
+{
+	wplRenderGroup* group;
+	isize first;
+	f32 scale, offsetX, offsetY;
+	f32 textureX, textureY;
+	// 2 / width and -2 / height, so normalizing is a multiply
+	f32 invWidth2, invHeight2;
+};
+
+/* One sprite's worth of what the 4-wide kernel does, for the tail */
+static
+void processSprite(wplGroupTransform* t, wplSprite* s, wplVertex* p)
+{
+	vf128 groupScale = _mm_set_ps1(t->scale);
+	f32 uvrect[4];
+	uvrect[0] = (f32)s->tx + t->textureX;
+	uvrect[1] = (f32)s->ty + t->textureY;
+	uvrect[2] = (f32)(s->tx + s->tw) + t->textureX; 
+	uvrect[3] = (f32)(s->ty + s->th) + t->textureY;
+
+	int f = s->flags & 0xf;
+	vf128 xs = _mm_add_ps(_mm_set_ps(-0.5, -0.5, 0.5, 0.5),
+			_mm_set1_ps(SoffsetX[f]));
+	vf128 ys = _mm_add_ps(_mm_set_ps(0.5, -0.5, 0.5, -0.5),
+			_mm_set1_ps(SoffsetY[f]));
+	vf128 uvxs = _mm_set_ps(uvrect[0], uvrect[0], uvrect[2], uvrect[2]);
+	vf128 uvys = _mm_set_ps(uvrect[3], uvrect[1], uvrect[3], uvrect[1]);
+
+	f32 scaleX = s->w;
+	f32 scaleY = s->h;
+	if(s->flags & Sprite_RotateCW) {
+		uvxs = vfShuffle(uvxs, 3, 1, 2, 0);
+		uvys = vfShuffle(uvys, 3, 1, 2, 0);
+		scaleX = s->h;
+		scaleY = s->w;
+	}
 
-		glVertexAttribPointer(i, 4, GL_SHORT, 0, stride, spriteMember(tx));
-		glEnableVertexAttribArray(i);
-		glVertexAttribDivisor(i++, 1);
+	if(s->flags & Sprite_RotateCCW) {
+		uvxs = vfShuffle(uvxs, 2, 0, 3, 1);
+		uvys = vfShuffle(uvys, 2, 0, 3, 1);
+		scaleX = s->h;
+		scaleY = s->w;
+	}
 
-		glVertexAttribPointer(i, 1, GL_FLOAT, 0, stride, spriteMember(angle));
-		glEnableVertexAttribArray(i);
-		glVertexAttribDivisor(i++, 1);
-		glBindVertexArray(0);
+	xs = _mm_mul_ps(xs, _mm_set_ps1(scaleX * t->scale));
+	ys = _mm_mul_ps(ys, _mm_set_ps1(scaleY * t->scale));
+
+	/* Rotations 
+	 * -angle yields the correct rotation for inverted Y, matching
+	 *  the shader version.
+	 * */
+	if(s->angle != 0) {
+		vf128 lsin, lcos;
+		wbtm_sse2_sincos_ps(_mm_set_ps1(-s->angle), &lsin, &lcos);
+
+		vf128 centerX = _mm_set_ps1(s->cx);
+		vf128 centerY = _mm_set_ps1(s->cy);
+
+		xs = _mm_sub_ps(xs, centerX);
+		ys = _mm_sub_ps(ys, centerY);
+		
+		vf128 cxs = _mm_mul_ps(lcos, xs);
+		vf128 sxs = _mm_mul_ps(lsin, xs);
+
+		vf128 cys = _mm_mul_ps(lcos, ys);
+		vf128 sys = _mm_mul_ps(lsin, ys);
+
+		xs = _mm_add_ps(cxs, sys);
+		ys = _mm_sub_ps(cys, sxs);
+
+		xs = _mm_add_ps(xs, centerX);
+		ys = _mm_add_ps(ys, centerY);
+	}
+
+	xs = _mm_add_ps(xs, _mm_mul_ps(_mm_set_ps1(s->x), groupScale));
+	xs = _mm_sub_ps(xs, _mm_set_ps1(t->offsetX));
+	ys = _mm_add_ps(ys, _mm_mul_ps(_mm_set_ps1(s->y), groupScale));
+	ys = _mm_sub_ps(ys, _mm_set_ps1(t->offsetY));
+
+	/* Normalize the position to -1, 1 based on the window size
+	 * pos * vec2(2, -2) / viewportWH - vec2(1, -1)
+	 */
+	xs = _mm_sub_ps(_mm_mul_ps(xs, _mm_set_ps1(t->invWidth2)), 
+			_mm_set_ps1(1));
+	ys = _mm_add_ps(_mm_mul_ps(ys, _mm_set_ps1(t->invHeight2)), 
+			_mm_set_ps1(1));
+
+	vf32x4 x = {xs}, y = {ys}, uvx = {uvxs}, uvy = {uvys};
+	for(isize j = 0; j < 4; ++j) {
+		p[j].x = x.f[j];
+		p[j].y = y.f[j];
+		p[j].u = uvx.f[j];
+		p[j].v = uvy.f[j];
+		p[j].color = s->color;
+		p[j].flags = s->flags & Sprite_NoAA ? 1.0 : 0.0;
 	}
 }
 
-float SoffsetX[] = {0.0, 0.5, 0.0, -0.5, -0.5, -0.5,  0.0,  0.5, 0.5};
-float SoffsetY[] = {0.0, 0.5, 0.5,  0.5,  0.0, -0.5, -0.5, -0.5, 0.0};
-static
-void groupProcessSprites(wplState* state, wplRenderGroup* group)
+/* Four sprites transposed so each register holds one field of all four */
+typedef struct wplSpriteLanes wplSpriteLanes;
+struct wplSpriteLanes
 {
-	vf128 groupScale = _mm_set_ps1(group->scale);
-	vf128 offsetXs = _mm_set_ps1(group->offsetX);
-	vf128 offsetYs = _mm_set_ps1(group->offsetY);
-	vf128 viewportXs = _mm_set_ps1((f32)state->width);
-	vf128 viewportYs = _mm_set_ps1((f32)state->height);
-	for(isize i = 0; i < group->count; ++i) {
-		wplSprite* s = group->sprites + i;
-		wplVertex* p = group->verts + (i*4);
-		group->indices[i] = i * 4;	
-		group->vertCounts[i] = 4;
+	vf128 x, y, w, h, cx, cy, angle;
+	vf128 tx, ty, tw, th;
+	vf128 anchorX, anchorY;
+	vi128 flags;
+};
+
+/* Per vertex, per sprite output; x[j] is vertex j of all four sprites */
+typedef struct wplVertexLanes wplVertexLanes;
+struct wplVertexLanes
+{
+	vf128 x[4], y[4], u[4], v[4];
+};
 
-		f32 uvrect[4];
-		uvrect[0] = (f32)s->tx;
-		uvrect[1] = (f32)s->ty;
-		uvrect[2] = (f32)(s->tx + s->tw); 
-		uvrect[3] = (f32)(s->ty + s->th);
+static
+void gatherSprites4(wplSprite* s, wplSpriteLanes* l)
+{
+	vf128 r0 = _mm_loadu_ps(&s[0].x);
+	vf128 r1 = _mm_loadu_ps(&s[1].x);
+	vf128 r2 = _mm_loadu_ps(&s[2].x);
+	vf128 r3 = _mm_loadu_ps(&s[3].x);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	l->x = r0;
+	l->y = r1;
+	l->w = r2;
+	l->h = r3;
+
+	vf128 c01 = _mm_loadl_pi(_mm_setzero_ps(), (__m64*)&s[0].cx);
+	c01 = _mm_loadh_pi(c01, (__m64*)&s[1].cx);
+	vf128 c23 = _mm_loadl_pi(_mm_setzero_ps(), (__m64*)&s[2].cx);
+	c23 = _mm_loadh_pi(c23, (__m64*)&s[3].cx);
+	l->cx = _mm_shuffle_ps(c01, c23, _MM_SHUFFLE(2, 0, 2, 0));
+	l->cy = _mm_shuffle_ps(c01, c23, _MM_SHUFFLE(3, 1, 3, 1));
+
+	// tx, ty, tw, th are i16; sign extend to i32 by unpacking into the
+	// high halves and shifting back down
+	vi128 t01 = _mm_unpacklo_epi64(
+			_mm_loadl_epi64((vi128*)&s[0].tx),
+			_mm_loadl_epi64((vi128*)&s[1].tx));
+	vi128 t23 = _mm_unpacklo_epi64(
+			_mm_loadl_epi64((vi128*)&s[2].tx),
+			_mm_loadl_epi64((vi128*)&s[3].tx));
+	r0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(t01, t01), 16));
+	r1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(t01, t01), 16));
+	r2 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(t23, t23), 16));
+	r3 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(t23, t23), 16));
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	l->tx = r0;
+	l->ty = r1;
+	l->tw = r2;
+	l->th = r3;
+
+	l->angle = _mm_set_ps(s[3].angle, s[2].angle, s[1].angle, s[0].angle);
+	l->flags = _mm_set_epi32(s[3].flags, s[2].flags, s[1].flags, s[0].flags);
+}
 
-		int f = s->flags & 0xf;
-		vf128 xs = _mm_add_ps(_mm_set_ps(-0.5, -0.5, 0.5, 0.5),
-				_mm_set1_ps(SoffsetX[f]));
-		vf128 ys = _mm_add_ps(_mm_set_ps(0.5, -0.5, 0.5, -0.5),
-				_mm_set1_ps(SoffsetY[f]));
-		vf128 uvxs = _mm_set_ps(uvrect[0], uvrect[0], uvrect[2], uvrect[2]);
-		vf128 uvys = _mm_set_ps(uvrect[3], uvrect[1], uvrect[3], uvrect[1]);
+static
+void gatherAnchors4(wplSprite* s, wplSpriteLanes* l)
+{
+	l->anchorX = _mm_set_ps(
+			SoffsetX[s[3].flags & 0xF], SoffsetX[s[2].flags & 0xF],
+			SoffsetX[s[1].flags & 0xF], SoffsetX[s[0].flags & 0xF]);
+	l->anchorY = _mm_set_ps(
+			SoffsetY[s[3].flags & 0xF], SoffsetY[s[2].flags & 0xF],
+			SoffsetY[s[1].flags & 0xF], SoffsetY[s[0].flags & 0xF]);
+}
 
+/* Transposes back to one wplVertex per lane and writes all 16 */
+static
+void scatterVerts4(wplVertexLanes* v, wplSprite* s, wplVertex* p)
+{
+	vi128 tail[4];
+	for(isize k = 0; k < 4; ++k) {
+		f32 flags = s[k].flags & Sprite_NoAA ? 1.0f : 0.0f;
+		tail[k] = _mm_set_epi32(0, 0, *(i32*)&flags, s[k].color);
+	}
 
-		f32 scaleX = s->w;
-		f32 scaleY = s->h;
-		if(s->flags & Sprite_RotateCW) {
-			uvxs = vfShuffle(uvxs, 3, 1, 2, 0);
-			uvys = vfShuffle(uvys, 3, 1, 2, 0);
-			scaleX = s->h;
-			scaleY = s->w;
+	for(isize j = 0; j < 4; ++j) {
+		vf128 r0 = v->x[j], r1 = v->y[j], r2 = v->u[j], r3 = v->v[j];
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(&p[0 * 4 + j].x, r0);
+		_mm_storeu_ps(&p[1 * 4 + j].x, r1);
+		_mm_storeu_ps(&p[2 * 4 + j].x, r2);
+		_mm_storeu_ps(&p[3 * 4 + j].x, r3);
+		for(isize k = 0; k < 4; ++k) {
+			_mm_storel_epi64((vi128*)&p[k * 4 + j].color, tail[k]);
 		}
+	}
+}
 
-		if(s->flags & Sprite_RotateCCW) {
-			uvxs = vfShuffle(uvxs, 2, 0, 3, 1);
-			uvys = vfShuffle(uvys, 2, 0, 3, 1);
-			scaleX = s->h;
-			scaleY = s->w;
-		}
+static inline
+vf128 vfSelect(vf128 mask, vf128 a, vf128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
 
-		{
-			vf128 scaleXs = _mm_set_ps1(scaleX * group->scale);
-			vf128 scaleYs = _mm_set_ps1(scaleY * group->scale);
-			xs = _mm_mul_ps(xs, scaleXs);
-			ys = _mm_mul_ps(ys, scaleYs);
-		}
+static inline
+vf128 flagMask4(vi128 flags, i32 flag)
+{
+	vi128 f = _mm_set1_epi32(flag);
+	return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(flags, f), f));
+}
+
+// Vertex corners, and where RotateCW/RotateCCW take each vertex's uv from
+static const f32 cornerXs[4] = {0.5f, 0.5f, -0.5f, -0.5f};
+static const f32 cornerYs[4] = {-0.5f, 0.5f, -0.5f, 0.5f};
+static const i32 rotateCWFrom[4] = {0, 2, 1, 3};
+static const i32 rotateCCWFrom[4] = {1, 3, 0, 2};
 
-		/* Rotations 
-		 * -angle yields the correct rotation for inverted Y, matching
-		 *  the shader version.
-		 * */
-		if(s->angle != 0) {
-			vf128 lsin, lcos;
-			wbtm_sse2_sincos_ps(_mm_set_ps1(-s->angle), &lsin, &lcos);
+static
+void expandSprites4(wplGroupTransform* t, wplSpriteLanes* l, wplVertexLanes* v)
+{
+	vf128 rotCW = flagMask4(l->flags, Sprite_RotateCW);
+	vf128 rotCCW = flagMask4(l->flags, Sprite_RotateCCW);
+	vf128 rotated = _mm_or_ps(rotCW, rotCCW);
+	vf128 groupScale = _mm_set_ps1(t->scale);
+	vf128 sx = _mm_mul_ps(vfSelect(rotated, l->h, l->w), groupScale);
+	vf128 sy = _mm_mul_ps(vfSelect(rotated, l->w, l->h), groupScale);
+
+	vf128 u0 = _mm_add_ps(l->tx, _mm_set_ps1(t->textureX));
+	vf128 v1 = _mm_add_ps(l->ty, _mm_set_ps1(t->textureY));
+	vf128 u2 = _mm_add_ps(u0, l->tw);
+	vf128 v3 = _mm_add_ps(v1, l->th);
+	vf128 us[4] = {u2, u2, u0, u0};
+	vf128 vs[4] = {v1, v3, v1, v3};
+	for(isize j = 0; j < 4; ++j) {
+		v->u[j] = vfSelect(rotCW, us[rotateCWFrom[j]], us[j]);
+		v->v[j] = vfSelect(rotCW, vs[rotateCWFrom[j]], vs[j]);
+	}
+	for(isize j = 0; j < 4; ++j) {
+		us[j] = v->u[j];
+		vs[j] = v->v[j];
+	}
+	for(isize j = 0; j < 4; ++j) {
+		v->u[j] = vfSelect(rotCCW, us[rotateCCWFrom[j]], us[j]);
+		v->v[j] = vfSelect(rotCCW, vs[rotateCCWFrom[j]], vs[j]);
+	}
 
-			vf128 centerX = _mm_set_ps1(s->cx);
-			vf128 centerY = _mm_set_ps1(s->cy);
+	vf128 lsin, lcos;
+	wbtm_sse2_sincos_ps(_mm_sub_ps(_mm_setzero_ps(), l->angle), &lsin, &lcos);
+	vf128 spun = _mm_cmpneq_ps(l->angle, _mm_setzero_ps());
+
+	vf128 px = _mm_sub_ps(_mm_mul_ps(l->x, groupScale), _mm_set_ps1(t->offsetX));
+	vf128 py = _mm_sub_ps(_mm_mul_ps(l->y, groupScale), _mm_set_ps1(t->offsetY));
+	vf128 invW = _mm_set_ps1(t->invWidth2);
+	vf128 invH = _mm_set_ps1(t->invHeight2);
+	vf128 one = _mm_set_ps1(1);
+
+	for(isize j = 0; j < 4; ++j) {
+		vf128 xs = _mm_mul_ps(_mm_add_ps(_mm_set_ps1(cornerXs[j]), l->anchorX), sx);
+		vf128 ys = _mm_mul_ps(_mm_add_ps(_mm_set_ps1(cornerYs[j]), l->anchorY), sy);
+
+		vf128 dx = _mm_sub_ps(xs, l->cx);
+		vf128 dy = _mm_sub_ps(ys, l->cy);
+		vf128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lcos, dx), _mm_mul_ps(lsin, dy)), l->cx);
+		vf128 ry = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(lcos, dy), _mm_mul_ps(lsin, dx)), l->cy);
+		xs = vfSelect(spun, rx, xs);
+		ys = vfSelect(spun, ry, ys);
+
+		xs = _mm_add_ps(xs, px);
+		ys = _mm_add_ps(ys, py);
+		v->x[j] = _mm_sub_ps(_mm_mul_ps(xs, invW), one);
+		v->y[j] = _mm_add_ps(_mm_mul_ps(ys, invH), one);
+	}
+}
 
-			xs = _mm_sub_ps(xs, centerX);
-			ys = _mm_sub_ps(ys, centerY);
-			
-			vf128 cxs = _mm_mul_ps(lcos, xs);
-			vf128 sxs = _mm_mul_ps(lsin, xs);
+static inline WPL_TARGET_AVX2
+__m256 vfJoin(vf128 lo, vf128 hi)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
 
-			vf128 cys = _mm_mul_ps(lcos, ys);
-			vf128 sys = _mm_mul_ps(lsin, ys);
+/* The same math as expandSprites4 over eight sprites at once. Loads,
+ * stores and sincos stay 4-wide; the anchor lookup is a real gather. */
+static WPL_TARGET_AVX2
+void expandSprites8(wplGroupTransform* t, 
+		wplSpriteLanes* a, wplSpriteLanes* b, 
+		wplVertexLanes* va, wplVertexLanes* vb)
+{
+	__m256i flags = _mm256_insertf128_si256(
+			_mm256_castsi128_si256(a->flags), b->flags, 1);
+	__m256i anchor = _mm256_and_si256(flags, _mm256_set1_epi32(0xF));
+	__m256 anchorX = _mm256_i32gather_ps(SoffsetX, anchor, 4);
+	__m256 anchorY = _mm256_i32gather_ps(SoffsetY, anchor, 4);
+
+	__m256i cwBit = _mm256_set1_epi32(Sprite_RotateCW);
+	__m256i ccwBit = _mm256_set1_epi32(Sprite_RotateCCW);
+	__m256 rotCW = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+				_mm256_and_si256(flags, cwBit), cwBit));
+	__m256 rotCCW = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+				_mm256_and_si256(flags, ccwBit), ccwBit));
+	__m256 rotated = _mm256_or_ps(rotCW, rotCCW);
+
+	__m256 w = vfJoin(a->w, b->w), h = vfJoin(a->h, b->h);
+	__m256 groupScale = _mm256_set1_ps(t->scale);
+	__m256 sx = _mm256_mul_ps(_mm256_blendv_ps(w, h, rotated), groupScale);
+	__m256 sy = _mm256_mul_ps(_mm256_blendv_ps(h, w, rotated), groupScale);
+
+	__m256 u0 = _mm256_add_ps(vfJoin(a->tx, b->tx), 
+			_mm256_set1_ps(t->textureX));
+	__m256 v1 = _mm256_add_ps(vfJoin(a->ty, b->ty), 
+			_mm256_set1_ps(t->textureY));
+	__m256 u2 = _mm256_add_ps(u0, vfJoin(a->tw, b->tw));
+	__m256 v3 = _mm256_add_ps(v1, vfJoin(a->th, b->th));
+	__m256 us[4] = {u2, u2, u0, u0};
+	__m256 vs[4] = {v1, v3, v1, v3};
+	__m256 ucw[4], vcw[4], u[4], v[4];
+	for(isize j = 0; j < 4; ++j) {
+		ucw[j] = _mm256_blendv_ps(us[j], us[rotateCWFrom[j]], rotCW);
+		vcw[j] = _mm256_blendv_ps(vs[j], vs[rotateCWFrom[j]], rotCW);
+	}
+	for(isize j = 0; j < 4; ++j) {
+		u[j] = _mm256_blendv_ps(ucw[j], ucw[rotateCCWFrom[j]], rotCCW);
+		v[j] = _mm256_blendv_ps(vcw[j], vcw[rotateCCWFrom[j]], rotCCW);
+	}
 
-			xs = _mm_add_ps(cxs, sys);
-			ys = _mm_sub_ps(cys, sxs);
+	vf128 sinA, cosA, sinB, cosB;
+	wbtm_sse2_sincos_ps(_mm_sub_ps(_mm_setzero_ps(), a->angle), &sinA, &cosA);
+	wbtm_sse2_sincos_ps(_mm_sub_ps(_mm_setzero_ps(), b->angle), &sinB, &cosB);
+	__m256 lsin = vfJoin(sinA, sinB), lcos = vfJoin(cosA, cosB);
+	__m256 angle = vfJoin(a->angle, b->angle);
+	__m256 spun = _mm256_cmp_ps(angle, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+
+	__m256 cx = vfJoin(a->cx, b->cx), cy = vfJoin(a->cy, b->cy);
+	__m256 px = _mm256_sub_ps(_mm256_mul_ps(vfJoin(a->x, b->x), groupScale), 
+			_mm256_set1_ps(t->offsetX));
+	__m256 py = _mm256_sub_ps(_mm256_mul_ps(vfJoin(a->y, b->y), groupScale), 
+			_mm256_set1_ps(t->offsetY));
+	__m256 invW = _mm256_set1_ps(t->invWidth2);
+	__m256 invH = _mm256_set1_ps(t->invHeight2);
+	__m256 one = _mm256_set1_ps(1);
+
+	for(isize j = 0; j < 4; ++j) {
+		__m256 xs = _mm256_mul_ps(_mm256_add_ps(
+					_mm256_set1_ps(cornerXs[j]), anchorX), sx);
+		__m256 ys = _mm256_mul_ps(_mm256_add_ps(
+					_mm256_set1_ps(cornerYs[j]), anchorY), sy);
+
+		__m256 dx = _mm256_sub_ps(xs, cx);
+		__m256 dy = _mm256_sub_ps(ys, cy);
+		__m256 rx = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(lcos, dx), _mm256_mul_ps(lsin, dy)), cx);
+		__m256 ry = _mm256_add_ps(_mm256_sub_ps(
+					_mm256_mul_ps(lcos, dy), _mm256_mul_ps(lsin, dx)), cy);
+		xs = _mm256_blendv_ps(xs, rx, spun);
+		ys = _mm256_blendv_ps(ys, ry, spun);
+
+		xs = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(xs, px), invW), one);
+		ys = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(ys, py), invH), one);
+
+		va->x[j] = _mm256_castps256_ps128(xs);
+		vb->x[j] = _mm256_extractf128_ps(xs, 1);
+		va->y[j] = _mm256_castps256_ps128(ys);
+		vb->y[j] = _mm256_extractf128_ps(ys, 1);
+		va->u[j] = _mm256_castps256_ps128(u[j]);
+		vb->u[j] = _mm256_extractf128_ps(u[j], 1);
+		va->v[j] = _mm256_castps256_ps128(v[j]);
+		vb->v[j] = _mm256_extractf128_ps(v[j], 1);
+	}
+}
 
-			xs = _mm_add_ps(xs, centerX);
-			ys = _mm_add_ps(ys, centerY);
-		}
+static i32 wplHasAVX2 = -1;
 
-		{
-			vf128 pxs = _mm_set_ps1(s->x);
-			pxs = _mm_mul_ps(pxs, groupScale);
-			xs = _mm_add_ps(xs, pxs);
-			xs = _mm_sub_ps(xs, offsetXs);
+static
+void processSpriteRange(void* data, isize start, isize end)
+{
+	wplGroupTransform* t = data;
+	wplRenderGroup* group = t->group;
+	wplSpriteLanes la, lb;
+	wplVertexLanes va, vb;
+
+	start += t->first;
+	end += t->first;
+	isize i = start;
+	for(isize j = i; j + 4 <= end; j += 4) {
+		_mm_storeu_si128((vi128*)(group->indices + j), 
+				_mm_set_epi32(j * 4 + 12, j * 4 + 8, j * 4 + 4, j * 4));
+		_mm_storeu_si128((vi128*)(group->vertCounts + j), _mm_set1_epi32(4));
+	}
 
-			vf128 pys = _mm_set_ps1(s->y);
-			pys = _mm_mul_ps(pys, groupScale);
-			ys = _mm_add_ps(ys, pys);
-			ys = _mm_sub_ps(ys, offsetYs);
+	if(wplHasAVX2) {
+		for(; i + 8 <= end; i += 8) {
+			wplSprite* s = group->sprites + i;
+			gatherSprites4(s, &la);
+			gatherSprites4(s + 4, &lb);
+			expandSprites8(t, &la, &lb, &va, &vb);
+			scatterVerts4(&va, s, group->verts + i * 4);
+			scatterVerts4(&vb, s + 4, group->verts + (i + 4) * 4);
 		}
+	}
 
-		/* Normalize the position to -1, 1 based on the window size
-		 * pos * vec2(2, -2) / viewportWH - vec2(1, -1)
-		 */
-		{
-			vf128 number = _mm_set_ps1(2);
-			xs = _mm_mul_ps(xs, number);
-			xs = _mm_div_ps(xs, viewportXs);
-			number = _mm_set_ps1(1);
-			xs = _mm_sub_ps(xs, number);
+	for(; i + 4 <= end; i += 4) {
+		wplSprite* s = group->sprites + i;
+		gatherSprites4(s, &la);
+		gatherAnchors4(s, &la);
+		expandSprites4(t, &la, &va);
+		scatterVerts4(&va, s, group->verts + i * 4);
+	}
 
-			number = _mm_set_ps1(-2);
-			ys = _mm_mul_ps(ys, number);
-			ys = _mm_div_ps(ys, viewportYs);
-			number = _mm_set_ps1(-1);
-			ys = _mm_sub_ps(ys, number);
-		}
+	for(; i < end; ++i) {
+		group->indices[i] = i * 4;
+		group->vertCounts[i] = 4;
+		processSprite(t, group->sprites + i, group->verts + i * 4);
+	}
+}
 
-		vf32x4 x = {xs}, y = {ys}, uvx = {uvxs}, uvy = {uvys};
-		for(isize j = 0; j < 4; ++j) {
-			p[j].x = x.f[j];
-			p[j].y = y.f[j];
-			p[j].u = uvx.f[j];
-			p[j].v = uvy.f[j];
-			p[j].color = s->color;
-			p[j].flags = s->flags & Sprite_NoAA ? 1.0 : 0.0;
-		}
+/* Builds the vertices for sprites [start, end) of group */
+static
+void groupProcessSprites(wplState* state, wplRenderGroup* group,
+		isize start, isize end)
+{
+	if(start >= end) return;
+	if(wplHasAVX2 < 0) {
+		wplHasAVX2 = SDL_HasAVX2() ? 1 : 0;
+	}
+
+	wplGroupTransform t;
+	t.group = group;
+	t.first = start;
+	t.textureX = 0;
+	t.textureY = 0;
+	if(group->texture->atlas) {
+		t.textureX = group->texture->atlasX;
+		t.textureY = group->texture->atlasY;
+	}
+	t.scale = group->scale;
+	t.offsetX = group->offsetX;
+	t.offsetY = group->offsetY;
+	t.invWidth2 = 2.0f / (f32)state->width;
+	t.invHeight2 = -2.0f / (f32)state->height;
+
+	if(end - start >= WPL_PARALLEL_SPRITES) {
+		wplParallelFor(end - start, WPL_PARALLEL_SPRITES / 2, 
+				processSpriteRange, &t);
+	} else {
+		processSpriteRange(&t, 0, end - start);
 	}
 }
 
 void wplGroupDrawBasic(wplState* state, wplRenderGroup* group)
 {
 	wplShader* shader = group->shader;
+	wplTexture* texture = group->texture;
+	if(texture->atlas) {
+		texture = texture->atlas;
+	}
 
 	glUniform2f(
 			shader->uInvTextureSize,
-			1.0f / (f32)group->texture->w, 
-			1.0f / (f32)group->texture->h);
+			1.0f / (f32)texture->w, 
+			1.0f / (f32)texture->h);
 
-	glBindTexture(GL_TEXTURE_2D, group->texture->glIndex);
+	glBindTexture(GL_TEXTURE_2D, texture->glIndex);
 
-	groupProcessSprites(state, group);
+	if(group->clearOnDraw) {
+		groupProcessSprites(state, group, 0, group->count);
+	} else {
+		// Vertices bake in the viewport and group transform, so those
+		// changing means rebuilding all of them
+		if(state->width != group->builtWidth || 
+				state->height != group->builtHeight ||
+				group->scale != group->builtScale ||
+				group->offsetX != group->builtOffsetX ||
+				group->offsetY != group->builtOffsetY) {
+			groupMarkDirty(group, 0, group->count);
+			group->builtWidth = state->width;
+			group->builtHeight = state->height;
+			group->builtScale = group->scale;
+			group->builtOffsetX = group->offsetX;
+			group->builtOffsetY = group->offsetY;
+		}
+		i64 end = group->dirtyEnd < group->count ? group->dirtyEnd : group->count;
+		groupProcessSprites(state, group, group->dirtyStart, end);
+		group->dirtyStart = 0;
+		group->dirtyEnd = 0;
+	}
 
 	glBindBuffer(GL_ARRAY_BUFFER, group->vbo);
 	glBufferData(GL_ARRAY_BUFFER,
@@ -363,12 +1329,120 @@ void wplGroupDrawBasic(wplState* state, wplRenderGroup* group)
 
 	if(group->clearOnDraw) {
 		group->count = 0;
+		group->glyphSpanCount = 0;
 	}
 }
 
-void wplGroupDraw(wplWindow* window, wplState* state, wplRenderGroup* group)
+/* Copies the sprites of group that can land on screen from src to dest,
+ * which may be the same array, and returns how many there were. Hidden
+ * sprites are dropped here rather than in the vertex shader. Rotated 
+ * sprites get a loose bound around their rotation center. */
+static
+isize groupCullSprites(wplState* state, wplRenderGroup* group, 
+		wplSprite* src, wplSprite* dest, isize count)
 {
-	if(group->count == 0) return;
+	f32 scale = group->scale;
+	f32 minX = group->offsetX / scale;
+	f32 minY = group->offsetY / scale;
+	f32 maxX = (group->offsetX + state->width) / scale;
+	f32 maxY = (group->offsetY + state->height) / scale;
+
+	isize kept = 0;
+	for(isize i = 0; i < count; ++i) {
+		wplSprite* s = src + i;
+		f32 x0, y0, x1, y1;
+		if(s->angle == 0 && !(s->flags & (Sprite_RotateCW | Sprite_RotateCCW))) {
+			i32 anchor = s->flags & 0xF;
+			x0 = s->x + (SoffsetX[anchor] - 0.5f) * s->w;
+			y0 = s->y + (SoffsetY[anchor] - 0.5f) * s->h;
+			x1 = x0 + s->w;
+			y1 = y0 + s->h;
+		} else {
+			f32 r = (s->w > s->h ? s->w : s->h) * 1.5f + 
+				2.0f * (fabsf(s->cx) + fabsf(s->cy));
+			x0 = s->x - r;
+			y0 = s->y - r;
+			x1 = s->x + r;
+			y1 = s->y + r;
+		}
+
+		i32 visible = !(s->flags & Sprite_Hidden) &&
+			x1 >= minX && x0 <= maxX && 
+			y1 >= minY && y0 <= maxY;
+		dest[kept] = *s;
+		kept += visible;
+	}
+	return kept;
+}
+
+/* Binds the group's GPU copy, creating it the first time, and sends 
+ * whatever has changed since the last draw */
+static
+void groupUploadRetained(wplRenderGroup* group)
+{
+	if(group->retainedVbo && group->retainedCapacity != group->capacity) {
+		glDeleteBuffers(1, &group->retainedVbo);
+		group->retainedVbo = 0;
+	}
+	if(!group->retainedVbo) {
+		group->retainedCapacity = group->capacity;
+		glGenBuffers(1, &group->retainedVbo);
+		glBindBuffer(GL_ARRAY_BUFFER, group->retainedVbo);
+		glBufferData(GL_ARRAY_BUFFER,
+				sizeof(wplSprite) * group->capacity,
+				NULL,
+				GL_DYNAMIC_DRAW);
+		groupMarkDirty(group, 0, group->count);
+	} else {
+		glBindBuffer(GL_ARRAY_BUFFER, group->retainedVbo);
+	}
+
+	i64 end = group->dirtyEnd < group->count ? group->dirtyEnd : group->count;
+	if(group->dirtyStart < end) {
+		glBufferSubData(GL_ARRAY_BUFFER,
+				sizeof(wplSprite) * group->dirtyStart,
+				sizeof(wplSprite) * (end - group->dirtyStart),
+				group->localSprites + group->dirtyStart);
+	}
+	group->dirtyStart = 0;
+	group->dirtyEnd = 0;
+}
+
+static
+void setTintUniform(wplShader* shader, u32 tint)
+{
+	glUniform4f(shader->uTint, 
+			(f32)(tint & 0xFF) / 255.0f, 
+			(f32)((tint >> 8) & 0xFF) / 255.0f,
+			(f32)((tint >> 16) & 0xFF) / 255.0f,
+			(f32)((tint >> 24) & 0xFF) / 255.0f);
+}
+
+static
+void groupDraw(wplWindow* window, wplState* state, wplRenderGroup* group)
+{
+	if(!group->clearOnDraw) {
+		groupMoveToLocal(group);
+	}
+
+	// Groups that are cleared after drawing can be compacted in place.
+	// Ones still writing straight into the ring are left alone, since 
+	// reading mapped memory back costs more than the upload saves
+	if(group->clearOnDraw && group->sprites == group->localSprites) {
+		group->count = groupCullSprites(state, group, 
+				group->sprites, group->sprites, group->count);
+		if(group->count == 0) return;
+	}
+
+	if(window->soft) {
+		wplSoftDrawGroup(window->soft, group);
+		if(group->clearOnDraw) {
+			group->count = 0;
+			group->glyphSpanCount = 0;
+		}
+		return;
+	}
+
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 	wplShader* shader = group->shader;
@@ -381,40 +1455,636 @@ void wplGroupDraw(wplWindow* window, wplState* state, wplRenderGroup* group)
 	glUniform2f(shader->uViewport, 
 			state->width, 
 			state->height);
-	glUniform4f(shader->uTint, 
-			(f32)(group->tint & 0xFF) / 255.0f, 
-			(f32)((group->tint >> 8) & 0xFF) / 255.0f,
-			(f32)((group->tint >> 16) & 0xFF) / 255.0f,
-			(f32)((group->tint >> 24) & 0xFF) / 255.0f);
+	setTintUniform(shader, group->tint);
+	setUnpackUniform(shader, 0);
+
+	// Packed textures are drawn from their atlas, offset in the shader
+	wplTexture* texture = group->texture;
+	if(texture->atlas) {
+		glUniform2f(shader->uTextureOffset, 
+				texture->atlasX, texture->atlasY);
+		texture = texture->atlas;
+	} else {
+		glUniform2f(shader->uTextureOffset, 0, 0);
+	}
 
 	glUniform2f(
 			shader->uInvTextureSize,
-			1.0f / (f32)group->texture->w, 
-			1.0f / (f32)group->texture->h);
+			1.0f / (f32)texture->w, 
+			1.0f / (f32)texture->h);
 
 	glUniform1f(shader->uScale, group->scale);
 	glUniform2f(shader->uOffset, 
 			group->offsetX / group->scale,
 			group->offsetY / group->scale);
 
-	glBindTexture(GL_TEXTURE_2D, group->texture->glIndex);
+	glBindTexture(GL_TEXTURE_2D, texture->glIndex);
 	glBindVertexArray(group->vao);
+
+	if(!group->clearOnDraw) {
+		groupUploadRetained(group);
+		groupSpriteAttribs(0);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, group->count);
+		glBindVertexArray(0);
+		return;
+	}
+
 	glBindBuffer(GL_ARRAY_BUFFER, group->vbo);
-	glBufferData(GL_ARRAY_BUFFER,
-			sizeof(wplSprite) * group->count,
-			group->sprites,
-			GL_STREAM_DRAW);
+	if(group->ring && group->ringSegmentSize < group->capacity * WPL_RING_DRAWS) {
+		groupResizeRing(window, group);
+	}
+	if(!group->ring) {
+		glBufferData(GL_ARRAY_BUFFER,
+				sizeof(wplSprite) * group->count,
+				group->sprites,
+				GL_STREAM_DRAW);
+		groupSpriteAttribs(0);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, group->count);
+		glBindVertexArray(0);
+		group->count = 0;
+		group->glyphSpanCount = 0;
+		return;
+	}
+
+	// Sprites that were culled (or went through a batch) are in 
+	// localSprites, and get written into the ring here instead
+	wplSprite* instances = group->sprites;
+	if(instances == group->localSprites) {
+		instances = groupRingHead(group);
+		memcpy(instances, group->localSprites, 
+				sizeof(wplSprite) * group->count);
+	}
+
+	groupSpriteAttribs((u8*)instances - (u8*)group->ring);
 	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, group->count);
+	glBindVertexArray(0);
+	groupRingAdvance(group);
+
+	group->count = 0;
+	group->glyphSpanCount = 0;
+	group->sprites = groupRingHead(group);
+}
+
+void wplGroupDraw(wplWindow* window, wplState* state, wplRenderGroup* group)
+{
+	if(group->count == 0) return;
+	// Still loading; leave the group as if it had been drawn
+	if(group->texture && !wplTextureReady(group->texture)) {
+		if(group->clearOnDraw) {
+			group->count = 0;
+			group->glyphSpanCount = 0;
+		}
+		return;
+	}
+	profileDrawBegin(-1, group->count);
+	groupDraw(window, state, group);
+	profileDrawEnd();
+}
+
+void wplBatchInit(
+		wplWindow* window, 
+		wplBatch* batch, 
+		i64 cap, 
+		wplShader* shader, 
+		MemoryArena* arena)
+{
+	wplGroupInit(window, &batch->stream, cap, shader, NULL, arena);
+	batch->window = window;
+	batch->state = NULL;
+	batch->capacity = cap;
+	batch->sprites = arenaPush(arena, sizeof(wplSprite) * cap);
+	batch->count = 0;
+	batch->runCount = 0;
+	batch->drawCalls = 0;
+	batch->stateChanges = 0;
+	batch->lastDrawCalls = 0;
+	batch->lastStateChanges = 0;
+	batch->culled = 0;
+	batch->lastCulled = 0;
+	batch->submitted = 0;
+	batch->lastSubmitted = 0;
+	batch->spills = 0;
+	batch->lastSpills = 0;
+	batch->uploaded = 0;
+	batch->lastUploaded = 0;
+}
+
+/* Scale is quantized to 1/256ths here; it only orders runs, merging 
+ * compares the real values. The submit order in the low bits keeps the
+ * sort stable, so runs sharing a layer and texture draw in the order 
+ * they were submitted. */
+static
+u64 batchKey(i32 layer, wplTexture* texture, wplRenderGroup* group, i64 order)
+{
+	u64 scale = (u64)(group->scale * 256.0f) & 0xFFFF;
+	return ((u64)(layer & 0xFFFF) << 48) | 
+		((u64)(texture->glIndex & 0xFFFF) << 32) | 
+		(scale << 16) | 
+		(u64)(order & 0xFFFF);
+}
+
+static
+i32 batchKeyLayer(u64 key)
+{
+	return (i32)(key >> 48);
+}
+
+static
+i32 batchRunsMatch(wplBatchRun* a, wplBatchRun* b)
+{
+	return !a->retained && !b->retained &&
+		a->texture == b->texture &&
+		a->scale == b->scale && 
+		a->offsetX == b->offsetX &&
+		a->offsetY == b->offsetY &&
+		a->tint == b->tint &&
+		a->textureX == b->textureX &&
+		a->textureY == b->textureY &&
+		a->format == b->format &&
+		a->glyphs == b->glyphs;
+}
 
+/* Whether the batch's draws can take packed and glyph instances; the
+ * basic and software paths only draw wplSprites */
+static
+i32 batchCanPack(wplWindow* window)
+{
+	return window->glVersion >= 33 && !window->soft;
+}
+
+typedef struct wplBatchGather wplBatchGather;
+struct wplBatchGather
+{
+	u8* out;
+	isize head;
+	wplBatchRun* runs;
+	i64 count;
+	i32 canPack;
+};
+
+/* Writes count of a run's sprites to the stream in the smallest format 
+ * they fit (glyphs come already packed), merging them into the last run
+ * written when the draw state matches */
+static
+void batchEmit(wplBatchGather* g, wplBatchRun* from, 
+		wplSprite* src, i64 count, wplGlyphSprite* glyphs)
+{
+	if(count == 0) return;
+	wplBatchRun run = *from;
+	run.count = count;
+	u8* dest = g->out + g->head;
+	isize size;
+	if(glyphs) {
+		run.format = Instance_Glyph;
+		size = sizeof(wplGlyphSprite) * count;
+		memcpy(dest, glyphs, size);
+	} else {
+		// Everything but glyphs has the atlas offset in its tx, ty already
+		run.textureX = 0;
+		run.textureY = 0;
+		run.glyphs = NULL;
+		run.format = Instance_Packed;
+		size = sizeof(wplPackedSprite) * count;
+		if(!g->canPack || !packSprites(src, (wplPackedSprite*)dest, count)) {
+			run.format = Instance_Sprite;
+			size = sizeof(wplSprite) * count;
+			memcpy(dest, src, size);
+		}
+	}
+
+	if(g->count > 0 && batchRunsMatch(g->runs + g->count - 1, &run)) {
+		g->runs[g->count - 1].count += count;
+	} else {
+		run.offset = g->head;
+		g->runs[g->count++] = run;
+	}
+	g->head += size;
+}
+
+static
+void batchDraw(wplBatch* batch)
+{
+	if(batch->runCount == 0) return;
+	wplWindow* window = batch->window;
+	wplState* state = batch->state;
+	wplRenderGroup* stream = &batch->stream;
+	wplBatchRun* runs = batch->runs;
+
+	// There are only ever a handful of runs, so insertion sort is plenty
+	for(i64 i = 1; i < batch->runCount; ++i) {
+		wplBatchRun run = runs[i];
+		i64 j = i - 1;
+		while(j >= 0 && runs[j].key > run.key) {
+			runs[j + 1] = runs[j];
+			j--;
+		}
+		runs[j + 1] = run;
+	}
+
+	// Gather the sprites in key order; the stream's sprites are the ring
+	// head when we have one, so this is also the upload. Runs that fit
+	// are packed on the way; packed ones are never bigger, so the stream
+	// has room either way. Runs with a glyph table split around each long
+	// enough stretch of glyphs, which makes more runs than came in
+	MemoryArena* scratch = arenaThreadScratch();
+	ArenaCheckpoint cp = arenaCheckpoint(scratch);
+	wplSprite* dest = stream->sprites;
+	wplBatchGather g;
+	g.out = (u8*)dest;
+	g.head = 0;
+	g.count = 0;
+	g.canPack = batchCanPack(window);
+	g.runs = arenaPush(scratch, sizeof(wplBatchRun) * 
+			(batch->runCount * 2 + batch->count / WPL_GLYPH_MIN_RUN * 2));
+	for(i64 i = 0; i < batch->runCount; ++i) {
+		wplBatchRun* run = runs + i;
+		if(run->retained) {
+			g.runs[g.count++] = *run;
+			continue;
+		}
+		wplSprite* src = batch->sprites + run->start;
+		// Staged from a group's glyph spans, so already instances
+		if(run->format == Instance_Glyph) {
+			batchEmit(&g, run, NULL, run->count, (wplGlyphSprite*)src);
+			continue;
+		}
+		if(!g.canPack || !run->glyphs) {
+			batchEmit(&g, run, src, run->count, NULL);
+			continue;
+		}
+
+		wplGlyphSprite* glyphs = arenaPush(scratch, 
+				sizeof(wplGlyphSprite) * run->count);
+		u8* isGlyph = arenaPush(scratch, run->count);
+		for(i64 j = 0; j < run->count; ++j) {
+			isGlyph[j] = packGlyph(run->glyphs, src + j, 
+					run->textureX, run->textureY, glyphs + j);
+		}
+		i64 start = 0;
+		for(i64 j = 0; j < run->count;) {
+			if(!isGlyph[j]) {
+				j++;
+				continue;
+			}
+			i64 end = j;
+			while(end < run->count && isGlyph[end]) end++;
+			if(end - j >= WPL_GLYPH_MIN_RUN) {
+				batchEmit(&g, run, src + start, j - start, NULL);
+				batchEmit(&g, run, src + j, end - j, glyphs + j);
+				start = end;
+			}
+			j = end;
+		}
+		batchEmit(&g, run, src + start, run->count - start, NULL);
+	}
+	runs = g.runs;
+	i64 mergedCount = g.count;
+	u8* out = g.out;
+	isize head = g.head;
+	// In wplSprites, which is what the ring counts in
+	stream->count = (head + sizeof(wplSprite) - 1) / sizeof(wplSprite);
+	batch->uploaded += head;
+
+	if(window->glVersion < 33) {
+		// The basic path rebuilds all its state per draw anyway, and 
+		// the software one doesn't have any
+		for(i64 i = 0; i < mergedCount; ++i) {
+			wplBatchRun* run = runs + i;
+			profileDrawBegin(batchKeyLayer(run->key), run->count);
+			if(run->retained) {
+				wplGroupDraw(window, state, run->retained);
+				profileDrawEnd();
+				batch->drawCalls++;
+				batch->stateChanges++;
+				continue;
+			}
+			stream->sprites = (wplSprite*)(out + run->offset);
+			stream->count = run->count;
+			stream->texture = run->texture;
+			stream->scale = run->scale;
+			stream->offsetX = run->offsetX;
+			stream->offsetY = run->offsetY;
+			stream->tint = run->tint;
+			wplGroupDraw(window, state, stream);
+			profileDrawEnd();
+			batch->drawCalls++;
+			batch->stateChanges++;
+		}
+		stream->sprites = stream->localSprites;
+		stream->count = 0;
+		batch->count = 0;
+		batch->runCount = 0;
+		arenaRewind(cp);
+		return;
+	}
+
+	wplShader* shader = stream->shader;
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glUseProgram(shader->program);
+	glUniform2f(shader->uViewport, 
+			state->width, 
+			state->height);
+	glBindVertexArray(stream->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
+	batch->stateChanges++;
+
+	isize base = 0;
+	if(stream->ring) {
+		base = (u8*)dest - (u8*)stream->ring;
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, head, dest, GL_STREAM_DRAW);
+	}
+
+	wplBatchRun* last = NULL;
+	wplGlyphTable* glyphsSet = NULL;
+	for(i64 i = 0; i < mergedCount; ++i) {
+		wplBatchRun* run = runs + i;
+		if(!last || run->texture != last->texture) {
+			glBindTexture(GL_TEXTURE_2D, run->texture->glIndex);
+			glUniform2f(
+					shader->uInvTextureSize,
+					1.0f / (f32)run->texture->w, 
+					1.0f / (f32)run->texture->h);
+			batch->stateChanges++;
+		}
+
+		if(!last || run->scale != last->scale || 
+				run->offsetX != last->offsetX || 
+				run->offsetY != last->offsetY) {
+			glUniform1f(shader->uScale, run->scale);
+			glUniform2f(shader->uOffset, 
+					run->offsetX / run->scale,
+					run->offsetY / run->scale);
+			batch->stateChanges++;
+		}
+
+		if(!last || run->tint != last->tint) {
+			setTintUniform(shader, run->tint);
+			batch->stateChanges++;
+		}
+
+		if(!last || run->textureX != last->textureX || 
+				run->textureY != last->textureY) {
+			glUniform2f(shader->uTextureOffset, run->textureX, run->textureY);
+			batch->stateChanges++;
+		}
+
+		if(!last || run->format != last->format) {
+			setUnpackUniform(shader, run->format);
+			batch->stateChanges++;
+		}
+
+		if(run->glyphs && run->glyphs != glyphsSet) {
+			glUniform4iv(shader->uGlyphs, run->glyphs->count, 
+					run->glyphs->rects[0]);
+			glyphsSet = run->glyphs;
+			batch->stateChanges++;
+		}
+
+		if(run->retained) {
+			groupUploadRetained(run->retained);
+			groupSpriteAttribs(0);
+		} else {
+			if(last && last->retained) {
+				glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
+			}
+			if(run->format == Instance_Glyph) {
+				groupGlyphAttribs(base + run->offset);
+			} else if(run->format == Instance_Packed) {
+				groupPackedAttribs(base + run->offset);
+			} else {
+				groupSpriteAttribs(base + run->offset);
+			}
+		}
+		profileDrawBegin(batchKeyLayer(run->key), run->count);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, run->count);
+		profileDrawEnd();
+		batch->drawCalls++;
+		last = run;
+	}
 	glBindVertexArray(0);
 
+	if(stream->ring) {
+		groupRingAdvance(stream);
+		stream->sprites = groupRingHead(stream);
+	}
+	stream->count = 0;
+	batch->count = 0;
+	batch->runCount = 0;
+	arenaRewind(cp);
+}
+
+/* Culls count sprites from src into the batch and queues them as a run */
+static
+void batchStage(wplState* state, wplBatch* batch, wplRenderGroup* group,
+		i32 layer, wplSprite* src, i64 count)
+{
+	wplSprite* sprites = batch->sprites + batch->count;
+	i64 visible = groupCullSprites(state, group, src, sprites, count);
+	batch->culled += count - visible;
+	count = visible;
+	if(count == 0) return;
+
+	// Sprites address their own image; move them to where it was packed.
+	// Glyphs are matched against the table without it, and get it back
+	// from uTextureOffset
+	wplBatchRun* run = batch->runs + batch->runCount;
+	run->textureX = 0;
+	run->textureY = 0;
+	wplTexture* texture = group->texture;
+	if(texture->atlas) {
+		for(i64 i = 0; i < count; ++i) {
+			sprites[i].tx += texture->atlasX;
+			sprites[i].ty += texture->atlasY;
+		}
+		if(group->glyphs) {
+			run->textureX = texture->atlasX;
+			run->textureY = texture->atlasY;
+		}
+		texture = texture->atlas;
+	}
+
+	run->key = batchKey(layer, texture, group, batch->runCount);
+	run->texture = texture;
+	run->scale = group->scale;
+	run->offsetX = group->offsetX;
+	run->offsetY = group->offsetY;
+	run->tint = group->tint;
+	run->start = batch->count;
+	run->count = count;
+	run->offset = 0;
+	run->format = Instance_Sprite;
+	run->glyphs = group->glyphs;
+	run->retained = NULL;
+	batch->count += count;
+	batch->runCount++;
+}
+
+/* Groups bigger than the room left are staged in pieces, drawing
+ * what's queued in between; that costs draw calls, but nothing's lost */
+static
+void batchStagePieces(wplState* state, wplBatch* batch, wplRenderGroup* group,
+		i32 layer, i64 start, i64 end)
+{
+	for(i64 done = start; done < end;) {
+		i64 count = end - done;
+		if((batch->count > 0 && count > batch->capacity - batch->count) || 
+				batch->runCount == WPL_BATCH_MAX_RUNS) {
+			batchDraw(batch);
+			batch->spills++;
+		}
+		if(count > batch->capacity) count = batch->capacity;
+		batchStage(state, batch, group, layer, 
+				group->sprites + done, count);
+		done += count;
+	}
+}
+
+/* Copies one of a group's glyph spans into the batch as-is, as a run 
+ * that's already in Instance_Glyph. They take less room than the sprites
+ * would, and aren't culled; a span is a few lines of text at most. */
+static
+void batchStageGlyphs(wplBatch* batch, wplRenderGroup* group, 
+		i32 layer, wplGlyphSpan* span)
+{
+	i64 perSprite = sizeof(wplSprite) / sizeof(wplGlyphSprite);
+	for(i64 done = 0; done < span->count;) {
+		i64 count = span->count - done;
+		i64 room = (batch->capacity - batch->count) * perSprite;
+		if((batch->count > 0 && count > room) || 
+				batch->runCount == WPL_BATCH_MAX_RUNS) {
+			batchDraw(batch);
+			batch->spills++;
+			room = batch->capacity * perSprite;
+		}
+		if(count > room) count = room;
+
+		wplBatchRun* run = batch->runs + batch->runCount;
+		memcpy(batch->sprites + batch->count, 
+				group->glyphSprites + span->start + done,
+				sizeof(wplGlyphSprite) * count);
+		run->textureX = 0;
+		run->textureY = 0;
+		wplTexture* texture = group->texture;
+		if(texture->atlas) {
+			run->textureX = texture->atlasX;
+			run->textureY = texture->atlasY;
+			texture = texture->atlas;
+		}
+		run->key = batchKey(layer, texture, group, batch->runCount);
+		run->texture = texture;
+		run->scale = group->scale;
+		run->offsetX = group->offsetX;
+		run->offsetY = group->offsetY;
+		run->tint = group->tint;
+		run->start = batch->count;
+		run->count = count;
+		run->offset = 0;
+		run->format = Instance_Glyph;
+		run->glyphs = group->glyphs;
+		run->retained = NULL;
+		batch->count += (count + perSprite - 1) / perSprite;
+		batch->runCount++;
+		done += count;
+	}
+}
+
+void wplBatchSubmit(
+		wplWindow* window, 
+		wplState* state, 
+		wplBatch* batch, 
+		wplRenderGroup* group, 
+		i32 layer)
+{
+	if(group->count == 0) return;
+	if(group->texture && !wplTextureReady(group->texture)) {
+		if(group->clearOnDraw) {
+			group->count = 0;
+			group->glyphSpanCount = 0;
+		}
+		return;
+	}
+	batch->window = window;
+	batch->state = state;
+
+	if(batch->runCount == WPL_BATCH_MAX_RUNS) {
+		batchDraw(batch);
+	}
+
+	// Retained groups aren't copied; they draw from their own buffer
+	// and the atlas offset is applied in the shader
+	if(!group->clearOnDraw) {
+		groupMoveToLocal(group);
+		wplTexture* texture = group->texture;
+		wplBatchRun* run = batch->runs + batch->runCount;
+		run->textureX = 0;
+		run->textureY = 0;
+		if(texture->atlas) {
+			run->textureX = texture->atlasX;
+			run->textureY = texture->atlasY;
+			texture = texture->atlas;
+		}
+		run->key = batchKey(layer, texture, group, batch->runCount);
+		run->texture = texture;
+		run->scale = group->scale;
+		run->offsetX = group->offsetX;
+		run->offsetY = group->offsetY;
+		run->tint = group->tint;
+		run->start = 0;
+		run->count = group->count;
+		run->offset = 0;
+		run->format = Instance_Sprite;
+		run->glyphs = NULL;
+		run->retained = group;
+		batch->runCount++;
+		batch->submitted += group->count;
+		return;
+	}
+
+	// Submitted groups are read back on the CPU, which we don't want to
+	// do from write-combined ring memory
+	groupMoveToLocal(group);
+	batch->submitted += group->count;
+
+	// Glyph spans go in as instances, and the sprites around them as usual
+	i64 done = 0;
+	if(batchCanPack(window)) {
+		for(i64 i = 0; i < group->glyphSpanCount; ++i) {
+			wplGlyphSpan* span = group->glyphSpans + i;
+			batchStagePieces(state, batch, group, layer, done, span->start);
+			batchStageGlyphs(batch, group, layer, span);
+			done = span->start + span->count;
+		}
+	}
+	batchStagePieces(state, batch, group, layer, done, group->count);
+
 	if(group->clearOnDraw) {
 		group->count = 0;
+		group->glyphSpanCount = 0;
 	}
 }
 
+void wplBatchFlush(wplBatch* batch)
+{
+	batchDraw(batch);
+	batch->lastDrawCalls = batch->drawCalls;
+	batch->lastStateChanges = batch->stateChanges;
+	batch->lastCulled = batch->culled;
+	batch->lastSubmitted = batch->submitted;
+	batch->lastSpills = batch->spills;
+	batch->lastUploaded = batch->uploaded;
+	batch->drawCalls = 0;
+	batch->stateChanges = 0;
+	batch->culled = 0;
+	batch->submitted = 0;
+	batch->spills = 0;
+	batch->uploaded = 0;
+}
+
 void wplUploadTexture(wplTexture* texture)
 {
+	if(wplHeadless) return;
 	glGenTextures(1, &texture->glIndex);
 	glBindTexture(GL_TEXTURE_2D, texture->glIndex);
 
@@ -455,3 +2125,73 @@ wplTexture* wplLoadTexture(wplWindow* window, string filename, MemoryArena* aren
 	return ptex;
 }
 
+/* Packs as many of images as will fit into one square atlas no larger 
+ * than maxSize, each with a 1px clamped border so filtering doesn't bleed
+ * between neighbours. Packed images get atlas/atlasX/atlasY set, and the 
+ * sprite batch redirects them to the atlas at submit, so sprites keep 
+ * using each image's own coordinates. Images that didn't fit are left 
+ * alone; pack them into another atlas with a second call. 
+ * Returns NULL if nothing fit. The atlas is not uploaded. */
+wplTexture* wplPackAtlas(
+		wplTexture** images, 
+		i64 count, 
+		i64 maxSize,
+		MemoryArena* arena)
+{
+	i32 glMax = 0;
+	if(!wplHeadless) {
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &glMax);
+	}
+	if(glMax > 0 && maxSize > glMax) maxSize = glMax;
+	// wplSprite texture coords are i16
+	if(maxSize > 16384) maxSize = 16384;
+
+	MemoryArena* scratch = arenaThreadScratch();
+	ArenaCheckpoint cp = arenaCheckpoint(scratch);
+	stbrp_rect* rects = arenaPush(scratch, sizeof(stbrp_rect) * count);
+	stbrp_node* nodes = arenaPush(scratch, sizeof(stbrp_node) * maxSize);
+	stbrp_context context;
+
+	// Grow a power of two square until everything fits
+	i64 size = 256;
+	if(size > maxSize) size = maxSize;
+	while(1) {
+		for(i64 i = 0; i < count; ++i) {
+			rects[i].id = i;
+			rects[i].w = images[i]->w + 2;
+			rects[i].h = images[i]->h + 2;
+			rects[i].was_packed = 0;
+		}
+		stbrp_init_target(&context, size, size, nodes, size);
+		if(stbrp_pack_rects(&context, rects, count)) break;
+		if(size * 2 > maxSize) break;
+		size *= 2;
+	}
+
+	wplTexture* atlas = NULL;
+	for(i64 i = 0; i < count; ++i) {
+		stbrp_rect* r = rects + i;
+		if(!r->was_packed) continue;
+		if(!atlas) {
+			atlas = arenaPush(arena, sizeof(wplTexture));
+			memset(atlas, 0, sizeof(wplTexture));
+			atlas->w = size;
+			atlas->h = size;
+			atlas->pixels = arenaPush(arena, size * size * 4);
+			memset(atlas->pixels, 0, size * size * 4);
+		}
+
+		wplTexture* image = images[r->id];
+		wplCopyMemoryBlock(atlas->pixels, image->pixels,
+				0, 0, image->w, image->h,
+				r->x + 1, r->y + 1, size, size,
+				4, 1);
+		image->atlas = atlas;
+		image->atlasX = r->x + 1;
+		image->atlasY = r->y + 1;
+	}
+
+	arenaRewind(cp);
+	return atlas;
+}
+
@@ -84,7 +84,12 @@ const char* gl33Frag = "" "#version 330\n"
 "{\n"
 "	//NoTexture\n"
 "	vec4 baseColor = fColor;\n"
-"	if(!((fFlags & 0x20) > 0)) {\n"
+"	//Sdf: the edge is at 0.5, smoothed over about a screen pixel\n"
+"	if((fFlags & 0x800) > 0) {\n"
+"		float dist = texture(uTexture, fTexture * uInvTextureSize).a;\n"
+"		float w = fwidth(dist) * 0.5;\n"
+"		baseColor.a *= smoothstep(0.5 - w, 0.5 + w, dist);\n"
+"	} else if(!((fFlags & 0x20) > 0)) {\n"
 "		vec2 uv;\n"
 "		if((fFlags & (1<<13)) > 0) {\n"
 "			uv = floor(fTexture) + 0.5;\n"
@@ -126,6 +131,10 @@ const char* gl33Vert = "" "#version 330\n"
 "uniform vec2 uOffset;\n"
 "uniform vec2 uViewport;\n"
 "uniform float uScale;\n"
+"uniform vec2 uTextureOffset;\n"
+"uniform vec2 uUnpack;\n"
+"uniform ivec4 uGlyphs[128];\n"
+"uniform int uGlyphMode;\n"
 "float[4] corners = float[4](-0.5, -0.5, 0.5, 0.5); \n"
 "float[9] offsetX = float[9](0.0, 0.5, 0.0, -0.5, -0.5, -0.5,  0.0,  0.5, 0.5); \n" 
 "float[9] offsetY = float[9](0.0, 0.5, 0.5,  0.5,  0.0, -0.5, -0.5, -0.5, 0.0); \n"
@@ -144,7 +153,13 @@ const char* gl33Vert = "" "#version 330\n"
 "	int vx = gl_VertexID & 2; \n"
 "	int vy = ((gl_VertexID & 1) << 1) ^ 3; \n"
 "	int anchor = vFlags & 0xF;\n"
-"	vec2 size = vSize; \n"
+"	vec2 size = vSize * uUnpack.x; \n"
+"	vec4 texRect = vTexture;\n"
+"	//Glyphs: vSize is (glyph, scale)\n"
+"	if(uGlyphMode > 0) {\n"
+"		texRect = vec4(uGlyphs[int(vSize.x)]);\n"
+"		size = texRect.zw * vSize.y * (1.0 / 16.0);\n"
+"	}\n"
 "	vec2 pos = vec2(corners[vx], corners[vy]);\n"
 "	fPos = pos + vec2(0.5, 0.5);\n"
 "	pos += vec2(offsetX[anchor], offsetY[anchor]);\n"
@@ -158,14 +173,15 @@ const char* gl33Vert = "" "#version 330\n"
 "		size.xy = size.yx;\n"
 "	} \n"
 "	pos *= size; \n"
-"	vec2 rot = vec2(cos(vAngle), sin(vAngle));\n"
+"	float angle = vAngle * uUnpack.y;\n"
+"	vec2 rot = vec2(cos(angle), sin(angle));\n"
 "	mat2 rotmat = mat2(\n"
 "			rot.x, rot.y,\n"
 "			-rot.y, rot.x);\n"
 "	pos -= vCenter;\n"
 "	pos = rotmat * pos;\n"
 "	pos += vCenter;\n"
-"	pos += vPos;\n"
+"	pos += vPos * uUnpack.x;\n"
 "	pos -= uOffset;\n"
 "	pos *= uScale; \n"
 "#if 0\n"
@@ -178,7 +194,8 @@ const char* gl33Vert = "" "#version 330\n"
 "#endif\n"
 "	vec2 normalPos = pos * vec2(2, -2) / uViewport - vec2(1, -1);\n"
 "	gl_Position = vec4(normalPos, 0, 1);\n"
-"	vec4 texVec = vec4(vTexture.xy, vTexture.xy + vTexture.zw); \n"
+"	vec2 texOrigin = texRect.xy + uTextureOffset;\n"
+"	vec4 texVec = vec4(texOrigin, texOrigin + texRect.zw); \n"
 "	if((vFlags & (1<<8)) > 1) {\n"
 "		texVec.xyzw = texVec.zyxw; \n"
 "	} \n"
@@ -0,0 +1,416 @@
+/* A CPU version of the gl33 sprite shaders, for running without a GPU.
+ * Each sprite is set up once as the inverse of the vertex shader's
+ * transform, then the target is split into tiles that the worker pool
+ * fills in parallel, four pixels at a time. Tiles walk the sprites in
+ * submit order, so blending comes out the same as on the GPU. */
+
+#define WPL_SOFT_TILE 64
+
+typedef struct wplSoftSprite wplSoftSprite;
+struct wplSoftSprite
+{
+	// fPos at the screen origin, and how it changes per pixel
+	f32 originX, originY;
+	f32 fxdx, fxdy, fydx, fydy;
+	i32 x0, y0, x1, y1;
+
+	// Texel coordinate is tex + fPos * texSize, after flips
+	f32 texX, texY, texW, texH;
+	f32 texScaleX, texScaleY;
+	vf128 color;
+	i32 flags;
+};
+
+typedef struct wplSoftDraw wplSoftDraw;
+struct wplSoftDraw
+{
+	wplSoftTarget* target;
+	wplSoftSprite* sprites;
+	isize count;
+	wplTexture* texture;
+	vf128 tint;
+	f32 zoom;
+	i64 tilesX;
+};
+
+wplSoftTarget* wplSoftCreateTarget(i64 w, i64 h, MemoryArena* arena)
+{
+	wplSoftTarget* target = arenaPush(arena, sizeof(wplSoftTarget));
+	target->w = w;
+	target->h = h;
+	target->pixels = arenaPush(arena, sizeof(u32) * w * h);
+	target->clearColor = 0xFF000000;
+	wplSoftClear(target);
+	return target;
+}
+
+void wplSoftClear(wplSoftTarget* target)
+{
+	u32* p = target->pixels;
+	u32 color = target->clearColor;
+	for(i64 i = 0; i < target->w * target->h; ++i) {
+		p[i] = color;
+	}
+}
+
+void wplSoftWriteImage(wplSoftTarget* target, string filename)
+{
+	wplWriteImage(filename, target->w, target->h, target->pixels);
+}
+
+/* Checks a render against a known-good png. Returns how many pixels have
+ * a channel more than tolerance off, or -1 if the png can't be read or
+ * isn't the target's size. */
+i64 wplSoftCompareImage(wplSoftTarget* target, string filename, i32 tolerance, i32* maxDiff)
+{
+	i32 w, h, bpp;
+	u8* ref = stbi_load(filename, &w, &h, &bpp, STBI_rgb_alpha);
+	*maxDiff = 0;
+	if(!ref) return -1;
+	if(w != target->w || h != target->h) {
+		stbi_image_free(ref);
+		return -1;
+	}
+
+	u8* p = (u8*)target->pixels;
+	i64 differ = 0;
+	for(i64 i = 0; i < target->w * target->h; ++i) {
+		i32 worst = 0;
+		for(i64 c = 0; c < 4; ++c) {
+			i32 d = abs((i32)p[i * 4 + c] - (i32)ref[i * 4 + c]);
+			if(d > worst) worst = d;
+		}
+		if(worst > *maxDiff) *maxDiff = worst;
+		differ += worst > tolerance;
+	}
+	stbi_image_free(ref);
+	return differ;
+}
+
+static
+vf128 softUnpack(u32 pixel)
+{
+	vi128 zero = _mm_setzero_si128();
+	vi128 p = _mm_cvtsi32_si128(pixel);
+	p = _mm_unpacklo_epi16(_mm_unpacklo_epi8(p, zero), zero);
+	return _mm_mul_ps(_mm_cvtepi32_ps(p), _mm_set1_ps(1.0f / 255.0f));
+}
+
+static
+u32 softPack(vf128 color)
+{
+	vi128 p = _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(255.0f)));
+	p = _mm_packs_epi32(p, p);
+	p = _mm_packus_epi16(p, p);
+	return (u32)_mm_cvtsi128_si32(p);
+}
+
+static
+vf128 softTexel(wplTexture* texture, i32 x, i32 y)
+{
+	if(x < 0) x = 0;
+	if(y < 0) y = 0;
+	if(x >= texture->w) x = texture->w - 1;
+	if(y >= texture->h) y = texture->h - 1;
+	return softUnpack(((u32*)texture->pixels)[y * texture->w + x]);
+}
+
+static
+f32 softTexelAlpha(wplTexture* texture, i32 x, i32 y)
+{
+	if(x < 0) x = 0;
+	if(y < 0) y = 0;
+	if(x >= texture->w) x = texture->w - 1;
+	if(y >= texture->h) y = texture->h - 1;
+	return (f32)(((u32*)texture->pixels)[y * texture->w + x] >> 24) / 255.0f;
+}
+
+/* floor(t) + 0.5 for NoAA, subpixelAA otherwise, then what GL_LINEAR
+ * makes of that: the texel at floor(t), blended toward the next one */
+static
+vf128 softSample(wplSoftDraw* d, wplSoftSprite* s, f32 tu, f32 tv)
+{
+	f32 fu = floorf(tu), fv = floorf(tv);
+	i32 iu = (i32)fu, iv = (i32)fv;
+	if(s->flags & Sprite_NoAA) {
+		return softTexel(d->texture, iu, iv);
+	}
+
+	f32 au = 1.0f - wbtm_clampf(0, 1, (1.0f - (tu - fu)) * s->texScaleX * d->zoom);
+	f32 av = 1.0f - wbtm_clampf(0, 1, (1.0f - (tv - fv)) * s->texScaleY * d->zoom);
+	vf128 t00 = softTexel(d->texture, iu, iv);
+	vf128 t10 = softTexel(d->texture, iu + 1, iv);
+	vf128 t01 = softTexel(d->texture, iu, iv + 1);
+	vf128 t11 = softTexel(d->texture, iu + 1, iv + 1);
+	vf128 wu = _mm_set1_ps(au);
+	vf128 top = _mm_add_ps(t00, _mm_mul_ps(_mm_sub_ps(t10, t00), wu));
+	vf128 bottom = _mm_add_ps(t01, _mm_mul_ps(_mm_sub_ps(t11, t01), wu));
+	return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(av)));
+}
+
+/* Plain bilinear alpha, thresholded like the shader's Sdf branch. 
+ * fwidth there is the field's slope (0.5 / WPL_SDF_SPREAD a texel) over
+ * the texels per screen pixel */
+static
+f32 softSdfAlpha(wplSoftDraw* d, wplSoftSprite* s, f32 tu, f32 tv)
+{
+	tu -= 0.5f;
+	tv -= 0.5f;
+	f32 fu = floorf(tu), fv = floorf(tv);
+	i32 iu = (i32)fu, iv = (i32)fv;
+	f32 au = tu - fu, av = tv - fv;
+	f32 a00 = softTexelAlpha(d->texture, iu, iv);
+	f32 a10 = softTexelAlpha(d->texture, iu + 1, iv);
+	f32 a01 = softTexelAlpha(d->texture, iu, iv + 1);
+	f32 a11 = softTexelAlpha(d->texture, iu + 1, iv + 1);
+	f32 top = a00 + (a10 - a00) * au;
+	f32 bottom = a01 + (a11 - a01) * au;
+	f32 dist = top + (bottom - top) * av;
+
+	f32 pixels = s->texScaleX * d->zoom;
+	f32 w = pixels > 0 ? 0.25f / (WPL_SDF_SPREAD * pixels) : 0.5f;
+	f32 t = wbtm_clampf(0, 1, (dist - (0.5f - w)) / (2.0f * w));
+	return t * t * (3.0f - 2.0f * t);
+}
+
+/* The fragment shader, then ONE, ONE_MINUS_SRC_ALPHA onto dest */
+static
+u32 softShade(wplSoftDraw* d, wplSoftSprite* s, f32 fx, f32 fy, u32 dest)
+{
+	vf128 base = s->color;
+	if(s->flags & Sprite_Sdf) {
+		f32 a = softSdfAlpha(d, s,
+				s->texX + fx * s->texW,
+				s->texY + fy * s->texH);
+		base = _mm_mul_ps(base, _mm_set_ps(a, 1, 1, 1));
+	} else if(!(s->flags & Sprite_NoTexture)) {
+		vf128 texel = softSample(d, s,
+				s->texX + fx * s->texW,
+				s->texY + fy * s->texH);
+		base = _mm_mul_ps(texel, base);
+	}
+
+	vf128 alpha = _mm_shuffle_ps(base, base, _MM_SHUFFLE(3, 3, 3, 3));
+	vf128 tintAlpha = _mm_shuffle_ps(d->tint, d->tint, _MM_SHUFFLE(3, 3, 3, 3));
+	vf128 tinted = _mm_mul_ps(d->tint, alpha);
+	vf128 mixed = _mm_add_ps(base, _mm_mul_ps(_mm_sub_ps(tinted, base), tintAlpha));
+	// rgb is the tint mix, alpha stays the base alpha
+	mixed = _mm_shuffle_ps(mixed, _mm_unpackhi_ps(mixed, base),
+			_MM_SHUFFLE(3, 0, 1, 0));
+	vf128 src = _mm_mul_ps(mixed, alpha);
+
+	vf128 srcAlpha = _mm_shuffle_ps(src, src, _MM_SHUFFLE(3, 3, 3, 3));
+	vf128 inv = _mm_sub_ps(_mm_set1_ps(1.0f), srcAlpha);
+	return softPack(_mm_add_ps(src, _mm_mul_ps(softUnpack(dest), inv)));
+}
+
+static
+void softSpan(wplSoftDraw* d, wplSoftSprite* s, i32 x0, i32 x1, i32 y)
+{
+	u32* dest = d->target->pixels + y * d->target->w;
+	f32 py = (f32)y + 0.5f;
+	vf128 rowX = _mm_set1_ps(s->originX + s->fxdy * py);
+	vf128 rowY = _mm_set1_ps(s->originY + s->fydy * py);
+	vf128 fxdx = _mm_set1_ps(s->fxdx);
+	vf128 fydx = _mm_set1_ps(s->fydx);
+	vf128 lanes = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	vf128 zero = _mm_setzero_ps();
+	vf128 one = _mm_set1_ps(1.0f);
+	vf128 half = _mm_set1_ps(0.5f);
+	vf128 end = _mm_set1_ps((f32)x1);
+
+	for(i32 x = x0; x < x1; x += 4) {
+		vf128 px = _mm_add_ps(_mm_set1_ps((f32)x), lanes);
+		vf128 fx = _mm_add_ps(rowX, _mm_mul_ps(fxdx, px));
+		vf128 fy = _mm_add_ps(rowY, _mm_mul_ps(fydx, px));
+		vf128 mask = _mm_and_ps(_mm_cmpge_ps(fx, zero), _mm_cmplt_ps(fx, one));
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(fy, zero));
+		mask = _mm_and_ps(mask, _mm_cmplt_ps(fy, one));
+		mask = _mm_and_ps(mask, _mm_cmplt_ps(px, end));
+		if(s->flags & Sprite_Circle) {
+			vf128 dx = _mm_sub_ps(fx, half);
+			vf128 dy = _mm_sub_ps(fy, half);
+			vf128 dist2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			mask = _mm_and_ps(mask, _mm_cmple_ps(dist2, _mm_set1_ps(0.25f)));
+		}
+
+		i32 bits = _mm_movemask_ps(mask);
+		if(!bits) continue;
+		vf32x4 fxs = {fx}, fys = {fy};
+		for(i32 k = 0; k < 4; ++k) {
+			if(bits & (1 << k)) {
+				dest[x + k] = softShade(d, s, fxs.f[k], fys.f[k], dest[x + k]);
+			}
+		}
+	}
+}
+
+static
+void softDrawTiles(void* data, isize start, isize end)
+{
+	wplSoftDraw* d = data;
+	wplSoftTarget* target = d->target;
+	for(isize tile = start; tile < end; ++tile) {
+		i32 tx0 = (tile % d->tilesX) * WPL_SOFT_TILE;
+		i32 ty0 = (tile / d->tilesX) * WPL_SOFT_TILE;
+		i32 tx1 = tx0 + WPL_SOFT_TILE;
+		i32 ty1 = ty0 + WPL_SOFT_TILE;
+		if(tx1 > target->w) tx1 = target->w;
+		if(ty1 > target->h) ty1 = target->h;
+
+		for(isize i = 0; i < d->count; ++i) {
+			wplSoftSprite* s = d->sprites + i;
+			i32 x0 = s->x0 > tx0 ? s->x0 : tx0;
+			i32 y0 = s->y0 > ty0 ? s->y0 : ty0;
+			i32 x1 = s->x1 < tx1 ? s->x1 : tx1;
+			i32 y1 = s->y1 < ty1 ? s->y1 : ty1;
+			for(i32 y = y0; y < y1; ++y) {
+				softSpan(d, s, x0, x1, y);
+			}
+		}
+	}
+}
+
+/* Where the vertex shader puts fPos (fx, fy) of s, in pixels */
+static
+void softForward(wplRenderGroup* group, wplSprite* s,
+		f32 c, f32 sn, f32 fx, f32 fy, f32* outX, f32* outY)
+{
+	i32 anchor = s->flags & 0xF;
+	f32 px = fx - 0.5f + SoffsetX[anchor];
+	f32 py = fy - 0.5f + SoffsetY[anchor];
+	f32 w = s->w, h = s->h, t;
+	if(s->flags & Sprite_RotateCW) {
+		t = px; px = -py; py = t;
+		t = w; w = h; h = t;
+	}
+	if(s->flags & Sprite_RotateCCW) {
+		t = px; px = py; py = -t;
+		t = w; w = h; h = t;
+	}
+	px = px * w - s->cx;
+	py = py * h - s->cy;
+	f32 rx = c * px - sn * py + s->cx + s->x;
+	f32 ry = sn * px + c * py + s->cy + s->y;
+	*outX = rx * group->scale - group->offsetX;
+	*outY = ry * group->scale - group->offsetY;
+}
+
+/* Returns 0 for sprites that can't touch the target */
+static
+i32 softSetupSprite(wplSoftTarget* target, wplRenderGroup* group,
+		wplSprite* s, f32 textureX, f32 textureY, wplSoftSprite* out)
+{
+	if(s->flags & Sprite_Hidden) return 0;
+
+	f32 c = cosf(s->angle), sn = sinf(s->angle);
+	f32 ox, oy, ax, ay, bx, by;
+	softForward(group, s, c, sn, 0, 0, &ox, &oy);
+	softForward(group, s, c, sn, 1, 0, &ax, &ay);
+	softForward(group, s, c, sn, 0, 1, &bx, &by);
+	ax -= ox; ay -= oy;
+	bx -= ox; by -= oy;
+	f32 det = ax * by - bx * ay;
+	if(fabsf(det) < 1e-6f) return 0;
+
+	f32 minX = ox, maxX = ox, minY = oy, maxY = oy;
+	f32 xs[3] = {ox + ax, ox + bx, ox + ax + bx};
+	f32 ys[3] = {oy + ay, oy + by, oy + ay + by};
+	for(i32 i = 0; i < 3; ++i) {
+		if(xs[i] < minX) minX = xs[i];
+		if(xs[i] > maxX) maxX = xs[i];
+		if(ys[i] < minY) minY = ys[i];
+		if(ys[i] > maxY) maxY = ys[i];
+	}
+	if(maxX <= 0 || maxY <= 0 || minX >= target->w || minY >= target->h) {
+		return 0;
+	}
+	out->x0 = minX < 0 ? 0 : (i32)minX;
+	out->y0 = minY < 0 ? 0 : (i32)minY;
+	out->x1 = maxX > target->w ? target->w : (i32)ceilf(maxX);
+	out->y1 = maxY > target->h ? target->h : (i32)ceilf(maxY);
+
+	f32 inv = 1.0f / det;
+	out->fxdx = by * inv;
+	out->fxdy = -bx * inv;
+	out->fydx = -ay * inv;
+	out->fydy = ax * inv;
+	out->originX = -(out->fxdx * ox + out->fxdy * oy);
+	out->originY = -(out->fydx * ox + out->fydy * oy);
+
+	f32 u0 = s->tx + textureX, v0 = s->ty + textureY;
+	f32 u1 = u0 + s->tw, v1 = v0 + s->th, t;
+	if(s->flags & Sprite_FlipHoriz) {
+		t = u0; u0 = u1; u1 = t;
+	}
+	if(s->flags & Sprite_FlipVert) {
+		t = v0; v0 = v1; v1 = t;
+	}
+	out->texX = u0;
+	out->texY = v0;
+	out->texW = u1 - u0;
+	out->texH = v1 - v0;
+
+	f32 w = s->w, h = s->h;
+	if(s->flags & Sprite_RotateCW) {
+		t = w; w = h; h = t;
+	}
+	if(s->flags & Sprite_RotateCCW) {
+		t = w; w = h; h = t;
+	}
+	out->texScaleX = out->texW != 0 ? w / out->texW : 0;
+	out->texScaleY = out->texH != 0 ? h / out->texH : 0;
+
+	u32 color = s->color;
+	out->color = _mm_set_ps(
+			(f32)(color & 0xFF) / 255.0f,
+			(f32)((color >> 8) & 0xFF) / 255.0f,
+			(f32)((color >> 16) & 0xFF) / 255.0f,
+			(f32)((color >> 24) & 0xFF) / 255.0f);
+	out->flags = s->flags;
+	return 1;
+}
+
+void wplSoftDrawGroup(wplSoftTarget* target, wplRenderGroup* group)
+{
+	if(group->count == 0) return;
+	MemoryArena* scratch = arenaThreadScratch();
+	ArenaCheckpoint cp = arenaCheckpoint(scratch);
+
+	wplSoftDraw d;
+	d.target = target;
+	d.texture = group->texture;
+	f32 textureX = 0, textureY = 0;
+	if(d.texture && d.texture->atlas) {
+		textureX = d.texture->atlasX;
+		textureY = d.texture->atlasY;
+		d.texture = d.texture->atlas;
+	}
+
+	d.sprites = arenaPush(scratch, sizeof(wplSoftSprite) * group->count);
+	d.count = 0;
+	for(isize i = 0; i < group->count; ++i) {
+		wplSoftSprite* s = d.sprites + d.count;
+		if(softSetupSprite(target, group, group->sprites + i,
+					textureX, textureY, s)) {
+			// Without a texture there's nothing to sample
+			if(!d.texture) s->flags |= Sprite_NoTexture;
+			d.count++;
+		}
+	}
+
+	u32 tint = group->tint;
+	d.tint = _mm_set_ps(
+			(f32)((tint >> 24) & 0xFF) / 255.0f,
+			(f32)((tint >> 16) & 0xFF) / 255.0f,
+			(f32)((tint >> 8) & 0xFF) / 255.0f,
+			(f32)(tint & 0xFF) / 255.0f);
+	d.zoom = group->scale;
+	d.tilesX = (target->w + WPL_SOFT_TILE - 1) / WPL_SOFT_TILE;
+	i64 tilesY = (target->h + WPL_SOFT_TILE - 1) / WPL_SOFT_TILE;
+
+	if(d.count > 0) {
+		wplParallelFor(d.tilesX * tilesY, 1, softDrawTiles, &d);
+	}
+	arenaRewind(cp);
+}
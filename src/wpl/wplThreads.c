@@ -0,0 +1,101 @@
+/* A small pool of worker threads for splitting loops over big arrays.
+ * The calling thread works alongside the workers, and wplParallelFor
+ * doesn't return until every chunk is done, so the data it touches can
+ * live on the caller's stack or in its arenas. */
+
+#define WPL_MAX_WORKERS 8
+
+typedef void wplRangeProc(void* data, isize start, isize end);
+
+struct wplWorkerPool
+{
+	SDL_sem* start;
+	SDL_sem* done;
+	i32 workerCount;
+	i32 initialized;
+
+	wplRangeProc* proc;
+	void* data;
+	isize count, grain;
+	SDL_atomic_t nextChunk;
+};
+
+static struct wplWorkerPool wplWorkers;
+
+static
+void workerRunChunks(void)
+{
+	isize chunks = (wplWorkers.count + wplWorkers.grain - 1) / wplWorkers.grain;
+	while(1) {
+		isize chunk = SDL_AtomicAdd(&wplWorkers.nextChunk, 1);
+		if(chunk >= chunks) break;
+		isize start = chunk * wplWorkers.grain;
+		isize end = start + wplWorkers.grain;
+		if(end > wplWorkers.count) end = wplWorkers.count;
+		wplWorkers.proc(wplWorkers.data, start, end);
+	}
+}
+
+static
+int workerMain(void* data)
+{
+	while(1) {
+		SDL_SemWait(wplWorkers.start);
+		workerRunChunks();
+		SDL_SemPost(wplWorkers.done);
+	}
+	return 0;
+}
+
+static
+void initWorkers(void)
+{
+	wplWorkers.initialized = 1;
+	i32 count = SDL_GetCPUCount() - 1;
+	if(count > WPL_MAX_WORKERS) count = WPL_MAX_WORKERS;
+	if(count <= 0) return;
+
+	wplWorkers.start = SDL_CreateSemaphore(0);
+	wplWorkers.done = SDL_CreateSemaphore(0);
+	if(!wplWorkers.start || !wplWorkers.done) return;
+
+	for(i32 i = 0; i < count; ++i) {
+		SDL_Thread* thread = SDL_CreateThread(workerMain, "wplWorker", NULL);
+		if(!thread) break;
+		SDL_DetachThread(thread);
+		wplWorkers.workerCount++;
+	}
+}
+
+/* Calls proc over [0, count) in chunks of grain. Anything that fits in
+ * a single chunk just runs on the calling thread. */
+void wplParallelFor(isize count, isize grain, wplRangeProc* proc, void* data)
+{
+	if(count <= 0) return;
+	if(grain < 1) grain = 1;
+	if(!wplWorkers.initialized) {
+		initWorkers();
+	}
+
+	isize chunks = (count + grain - 1) / grain;
+	if(chunks <= 1 || wplWorkers.workerCount == 0) {
+		proc(data, 0, count);
+		return;
+	}
+
+	wplWorkers.proc = proc;
+	wplWorkers.data = data;
+	wplWorkers.count = count;
+	wplWorkers.grain = grain;
+	SDL_AtomicSet(&wplWorkers.nextChunk, 0);
+
+	i32 helpers = wplWorkers.workerCount;
+	if(helpers > chunks - 1) helpers = chunks - 1;
+	for(i32 i = 0; i < helpers; ++i) {
+		SDL_SemPost(wplWorkers.start);
+	}
+	workerRunChunks();
+	for(i32 i = 0; i < helpers; ++i) {
+		SDL_SemWait(wplWorkers.done);
+	}
+}